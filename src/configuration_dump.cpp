@@ -0,0 +1,32 @@
+/// \file configuration_dump.cpp
+///
+/// Prints a persisted system configuration, in any of the formats, as pretty
+/// JSON for debugging.
+
+#include "configuration_format.hpp"
+
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <system.json>\n";
+        return 1;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input.good())
+    {
+        std::cerr << "unable to open " << argv[1] << "\n";
+        return 1;
+    }
+    nlohmann::json configuration = readConfiguration(input);
+    if (configuration.is_discarded())
+    {
+        std::cerr << "unable to read " << argv[1] << "\n";
+        return 1;
+    }
+    std::cout << configuration.dump(4) << "\n";
+    return 0;
+}
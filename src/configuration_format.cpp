@@ -0,0 +1,48 @@
+#include "configuration_format.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+void writeConfiguration(std::ostream& output,
+                        const nlohmann::json& configuration,
+                        ConfigurationFormat format)
+{
+    if (format == ConfigurationFormat::json)
+    {
+        output << configuration;
+        return;
+    }
+    output.write(configurationMagic.data(), configurationMagic.size());
+    output.put(static_cast<char>(configurationFormatVersion));
+    output.put(static_cast<char>(format));
+    nlohmann::json::to_cbor(configuration, output);
+}
+
+nlohmann::json readConfiguration(std::istream& input)
+{
+    if (input.peek() != configurationMagic[0])
+    {
+        return nlohmann::json::parse(input, nullptr, false);
+    }
+
+    std::array<char, configurationMagic.size() + 2> header{};
+    input.read(header.data(), header.size());
+    if (!input.good() ||
+        !std::equal(configurationMagic.begin(), configurationMagic.end(),
+                    header.begin()))
+    {
+        return nlohmann::json::value_t::discarded;
+    }
+    auto version = static_cast<uint8_t>(header[configurationMagic.size()]);
+    auto format = static_cast<ConfigurationFormat>(
+        header[configurationMagic.size() + 1]);
+    if (version != configurationFormatVersion ||
+        format != ConfigurationFormat::cbor)
+    {
+        std::cerr << "unsupported configuration format version "
+                  << static_cast<int>(version) << " encoding "
+                  << static_cast<int>(format) << "\n";
+        return nlohmann::json::value_t::discarded;
+    }
+    return nlohmann::json::from_cbor(input, true, false);
+}
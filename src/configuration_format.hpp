@@ -0,0 +1,31 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+/// \brief The encoding the system configuration is persisted in.
+///
+/// Binary configurations start with a header: the magic "EMCF", a version
+/// byte and a byte naming the encoding, followed by the encoded document.
+/// Text JSON has no header, and as no JSON text starts with the magic, the
+/// two are told apart by the first byte.
+enum class ConfigurationFormat : uint8_t
+{
+    json = 0,
+    cbor = 1,
+};
+
+constexpr std::array<char, 4> configurationMagic = {'E', 'M', 'C', 'F'};
+constexpr uint8_t configurationFormatVersion = 1;
+
+/// \brief Stream configuration to output in format.
+void writeConfiguration(std::ostream& output,
+                        const nlohmann::json& configuration,
+                        ConfigurationFormat format);
+
+/// \brief Read a configuration in any of the formats.
+/// \return the configuration, discarded if it couldn't be read.
+nlohmann::json readConfiguration(std::istream& input);
@@ -0,0 +1,373 @@
+#include "configuration_persister.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/asio/post.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+ConfigurationPersister::ConfigurationPersister(
+    boost::asio::io_context& io, std::filesystem::path path,
+    std::chrono::milliseconds window, SyncPolicy syncPolicy, Mode mode,
+    std::chrono::seconds compactInterval, bool background,
+    ConfigurationFormat format) :
+    io(io),
+    timer(io), compactTimer(io), path(std::move(path)), window(window),
+    compactInterval(compactInterval), syncPolicy(syncPolicy), mode(mode),
+    format(format), background(background)
+{
+    journal = this->path;
+    journal += ".journal";
+    compacting = journal;
+    compacting += ".compacting";
+    if (background)
+    {
+        worker = std::thread(&ConfigurationPersister::run, this);
+    }
+}
+
+ConfigurationPersister::~ConfigurationPersister()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable())
+    {
+        worker.join();
+    }
+    if (journalFd >= 0)
+    {
+        close(journalFd);
+    }
+}
+
+void ConfigurationPersister::schedule(const nlohmann::json& configuration)
+{
+    pending = &configuration;
+    if (armed)
+    {
+        return;
+    }
+    armed = true;
+    timer.expires_after(window);
+    timer.async_wait([this](const boost::system::error_code& ec) {
+        armed = false;
+        if (ec)
+        {
+            return;
+        }
+        flush();
+    });
+}
+
+void ConfigurationPersister::recordChange(const nlohmann::json& configuration,
+                                          const std::string& pointer)
+{
+    if (mode == Mode::snapshot)
+    {
+        schedule(configuration);
+        return;
+    }
+
+    nlohmann::json value;
+    try
+    {
+        value = configuration.at(nlohmann::json::json_pointer(pointer));
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        // removed values are persisted as null
+    }
+    nlohmann::json change = {{"Pointer", pointer}, {"Value", std::move(value)}};
+    if (!append(change.dump() + "\n") || journalBytes >= compactBytes)
+    {
+        schedule(configuration);
+        return;
+    }
+    if (compactArmed)
+    {
+        return;
+    }
+    compactArmed = true;
+    compactTimer.expires_after(compactInterval);
+    compactTimer.async_wait(
+        [this, &configuration](const boost::system::error_code& ec) {
+        compactArmed = false;
+        if (ec)
+        {
+            return;
+        }
+        schedule(configuration);
+    });
+}
+
+size_t ConfigurationPersister::replay(nlohmann::json& configuration) const
+{
+    return replayJournal(compacting, configuration) +
+           replayJournal(journal, configuration);
+}
+
+void ConfigurationPersister::discardJournal()
+{
+    if (journalFd >= 0)
+    {
+        close(journalFd);
+        journalFd = -1;
+    }
+    std::error_code ec;
+    std::filesystem::remove(journal, ec);
+    std::filesystem::remove(compacting, ec);
+    journalBytes = 0;
+}
+
+size_t ConfigurationPersister::replayJournal(
+    const std::filesystem::path& journal, nlohmann::json& configuration)
+{
+    std::ifstream input(journal);
+    if (!input.good())
+    {
+        return 0;
+    }
+    size_t applied = 0;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        nlohmann::json change = nlohmann::json::parse(line, nullptr, false);
+        if (!change.is_object())
+        {
+            break;
+        }
+        auto findPointer = change.find("Pointer");
+        auto findValue = change.find("Value");
+        if (findPointer == change.end() || !findPointer->is_string() ||
+            findValue == change.end())
+        {
+            break;
+        }
+        try
+        {
+            configuration[nlohmann::json::json_pointer(
+                findPointer->get<std::string>())] = *findValue;
+        }
+        catch (const nlohmann::json::exception&)
+        {
+            break;
+        }
+        applied++;
+    }
+    if (!input.eof())
+    {
+        std::cerr << "ignoring the rest of " << journal << " after " << applied
+                  << " changes\n";
+    }
+    return applied;
+}
+
+bool ConfigurationPersister::append(const std::string& line)
+{
+    if (journalFd < 0)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(journal.parent_path(), ec);
+        journalFd = open(journal.c_str(),
+                         O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (journalFd < 0)
+        {
+            std::cerr << "error opening " << journal << "\n";
+            return false;
+        }
+    }
+    ssize_t written = ::write(journalFd, line.data(), line.size());
+    if (written != static_cast<ssize_t>(line.size()))
+    {
+        std::cerr << "error appending to " << journal << "\n";
+        return false;
+    }
+    if (syncPolicy == SyncPolicy::always && fdatasync(journalFd) != 0)
+    {
+        std::cerr << "error syncing " << journal << "\n";
+        return false;
+    }
+    journalBytes += line.size();
+    bytes += line.size();
+    return true;
+}
+
+// Starts a new journal, so that the changes in the old one are those the
+// write being started holds.
+void ConfigurationPersister::rotateJournal()
+{
+    if (mode != Mode::journal)
+    {
+        return;
+    }
+    if (journalFd >= 0)
+    {
+        close(journalFd);
+        journalFd = -1;
+    }
+    journalBytes = 0;
+    compactTimer.cancel();
+
+    std::error_code ec;
+    if (!std::filesystem::exists(journal, ec))
+    {
+        return;
+    }
+    if (!std::filesystem::exists(compacting, ec))
+    {
+        std::filesystem::rename(journal, compacting, ec);
+        return;
+    }
+    // an earlier compaction failed, its changes go ahead of the new ones
+    {
+        std::ifstream input(journal, std::ios::binary);
+        std::ofstream output(compacting, std::ios::binary | std::ios::app);
+        output << input.rdbuf();
+    }
+    std::filesystem::remove(journal, ec);
+}
+
+static bool syncPath(const std::filesystem::path& path, int flags)
+{
+    int fd = open(path.c_str(), flags | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+// Writes what write(output) streams over path atomically.  Safe to run on
+// the worker, as it only touches the file.  Returns the bytes written.
+template <typename Write>
+static std::optional<uint64_t> writeFile(const std::filesystem::path& path,
+                                         bool sync, Write&& write)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+
+    std::ofstream output(tempPath, std::ios::trunc | std::ios::binary);
+    write(output);
+    output.flush();
+    if (!output.good())
+    {
+        std::cerr << "error writing " << tempPath << "\n";
+        return std::nullopt;
+    }
+    uint64_t written = output.tellp();
+    output.close();
+
+    if (sync && !syncPath(tempPath, O_WRONLY))
+    {
+        std::cerr << "error syncing " << tempPath << "\n";
+        return std::nullopt;
+    }
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec)
+    {
+        std::cerr << "error renaming " << tempPath << ": " << ec.message()
+                  << "\n";
+        return std::nullopt;
+    }
+    if (sync && !syncPath(path.parent_path(), O_RDONLY | O_DIRECTORY))
+    {
+        std::cerr << "error syncing " << path.parent_path() << "\n";
+    }
+    return written;
+}
+
+bool ConfigurationPersister::flush()
+{
+    if (pending == nullptr || writing)
+    {
+        return true;
+    }
+    const nlohmann::json& configuration = *pending;
+    pending = nullptr;
+    rotateJournal();
+    version++;
+
+    if (!background)
+    {
+        // the serializer streams into the file, without building the whole
+        // document in memory first
+        auto write = [this, &configuration](std::ostream& output) {
+            writeConfiguration(output, configuration, format);
+        };
+        return finishWrite(
+            writeFile(path, syncPolicy == SyncPolicy::always, write), version);
+    }
+
+    // the configuration keeps changing on the io loop, so the worker is
+    // handed the serialized bytes rather than the configuration
+    std::ostringstream buffer;
+    writeConfiguration(buffer, configuration, format);
+    writing = true;
+    {
+        std::lock_guard lock(mutex);
+        queued = QueuedWrite{version, std::move(buffer).str()};
+    }
+    wake.notify_one();
+    return true;
+}
+
+bool ConfigurationPersister::finishWrite(std::optional<uint64_t> written,
+                                         uint64_t writtenVersion)
+{
+    writing = false;
+    if (written)
+    {
+        // the file now holds every change in the rotated journal, a failed
+        // write leaves it to be replayed
+        std::error_code ec;
+        std::filesystem::remove(compacting, ec);
+        bytes += *written;
+        writeCount++;
+        lastWritten = writtenVersion;
+    }
+    // writes scheduled while this one was in progress
+    if (pending != nullptr)
+    {
+        schedule(*pending);
+    }
+    return written.has_value();
+}
+
+void ConfigurationPersister::run()
+{
+    std::unique_lock lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this]() { return stopping || queued; });
+        if (!queued)
+        {
+            return;
+        }
+        QueuedWrite write = std::move(*queued);
+        queued.reset();
+        lock.unlock();
+
+        std::optional<uint64_t> written =
+            writeFile(path, syncPolicy == SyncPolicy::always,
+                      [&write](std::ostream& output) {
+            output.write(write.data.data(),
+                         static_cast<std::streamsize>(write.data.size()));
+        });
+        uint64_t writeVersion = write.version;
+        boost::asio::post(io, [this, written, writeVersion]() {
+            finishWrite(written, writeVersion);
+        });
+
+        lock.lock();
+    }
+}
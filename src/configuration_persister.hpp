@@ -0,0 +1,170 @@
+#pragma once
+
+#include "configuration_format.hpp"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+/// \brief Writes the system configuration to flash behind the callers' back.
+///
+/// Writes requested within the window are coalesced into one, made once the
+/// window has passed.  The configuration is written compactly, in the
+/// configured format, into a temporary file next to the target, which is then
+/// renamed over it, so a power loss leaves either the old or the new file in
+/// place.
+///
+/// In journal mode, changes made through recordChange are instead appended to
+/// a journal next to the file, one {"Pointer", "Value"} object per line.  The
+/// journal is compacted into a full write once it grows past a size or has
+/// been written to for the compaction interval.  The persisted configuration
+/// is the file with the journal replayed over it.
+///
+/// Written on the io loop, the configuration is streamed into the file without
+/// building the document in memory.  In the background, only the write and
+/// sync move to a worker thread: the configuration keeps changing on the io
+/// loop, so it is still serialized there, into a buffer holding the whole
+/// document, once per coalesced write.
+class ConfigurationPersister
+{
+  public:
+    enum class SyncPolicy
+    {
+        /// Leave flushing the data to flash to the kernel.
+        never,
+        /// fsync the file and its directory on every write.
+        always,
+    };
+
+    enum class Mode
+    {
+        /// Every change writes the whole configuration.
+        snapshot,
+        /// Changes are appended to a journal, compacted on a schedule.
+        journal,
+    };
+
+    /// A journal bigger than this is compacted without waiting for the
+    /// compaction interval.
+    static constexpr uint64_t compactBytes = 64 * 1024;
+
+    ConfigurationPersister(
+        boost::asio::io_context& io, std::filesystem::path path,
+        std::chrono::milliseconds window, SyncPolicy syncPolicy,
+        Mode mode = Mode::snapshot,
+        std::chrono::seconds compactInterval = std::chrono::minutes(5),
+        bool background = false,
+        ConfigurationFormat format = ConfigurationFormat::json);
+    ~ConfigurationPersister();
+
+    ConfigurationPersister(const ConfigurationPersister&) = delete;
+    ConfigurationPersister& operator=(const ConfigurationPersister&) = delete;
+
+    /// \brief Write configuration once the window has passed.
+    /// \param configuration the configuration, as it is at the time of the
+    /// write.  It has to outlive the write.
+    void schedule(const nlohmann::json& configuration);
+
+    /// \brief Persist a change to one value of configuration.
+    /// \param configuration the configuration, with the change already made.
+    /// It has to outlive the write.
+    /// \param pointer JSON pointer to the value that changed.
+    void recordChange(const nlohmann::json& configuration,
+                      const std::string& pointer);
+
+    /// \brief Apply the journal, including changes of a compaction that
+    /// didn't complete, to a configuration loaded from the file.
+    /// \return the number of changes applied.
+    size_t replay(nlohmann::json& configuration) const;
+
+    /// \brief Drop the journal, once what it held is in the file again.
+    void discardJournal();
+
+    /// \brief Apply a journal to a configuration loaded from the file.
+    /// Replay stops at the first line that can't be applied, such as one torn
+    /// by a power loss.
+    /// \return the number of changes applied.
+    static size_t replayJournal(const std::filesystem::path& journal,
+                                nlohmann::json& configuration);
+
+    const std::filesystem::path& journalPath() const
+    {
+        return journal;
+    }
+
+    /// \brief Make a scheduled write now.  In the background, the write is
+    /// only started, and one already in progress picks up the scheduled
+    /// write once it's done.
+    /// \return false if the write failed.
+    bool flush();
+
+    /// \return the version of the last write that reached the file, in the
+    /// background.
+    uint64_t writtenVersion() const
+    {
+        return lastWritten;
+    }
+
+    uint64_t bytesWritten() const
+    {
+        return bytes;
+    }
+
+    uint64_t writes() const
+    {
+        return writeCount;
+    }
+
+  private:
+    /// The serialized configuration, as handed to the worker.
+    struct QueuedWrite
+    {
+        uint64_t version;
+        std::string data;
+    };
+
+    bool append(const std::string& line);
+    void rotateJournal();
+    bool finishWrite(std::optional<uint64_t> written, uint64_t version);
+    void run();
+
+    boost::asio::io_context& io;
+    boost::asio::steady_timer timer;
+    boost::asio::steady_timer compactTimer;
+    std::filesystem::path path;
+    std::filesystem::path journal;
+    // the journal of a compaction in progress, or of one that failed
+    std::filesystem::path compacting;
+    std::chrono::milliseconds window;
+    std::chrono::seconds compactInterval;
+    SyncPolicy syncPolicy;
+    Mode mode;
+    ConfigurationFormat format;
+    const nlohmann::json* pending = nullptr;
+    bool armed = false;
+    bool compactArmed = false;
+    int journalFd = -1;
+    uint64_t journalBytes = 0;
+    uint64_t bytes = 0;
+    uint64_t writeCount = 0;
+
+    bool background;
+    bool writing = false;
+    uint64_t version = 0;
+    uint64_t lastWritten = 0;
+    // shared with the worker
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::optional<QueuedWrite> queued;
+    bool stopping = false;
+    std::thread worker;
+};
@@ -17,7 +17,11 @@
 
 #include "entity_manager.hpp"
 
+#include "configuration_persister.hpp"
+#include "interface_registry.hpp"
 #include "overlay.hpp"
+#include "property_binding.hpp"
+#include "scan_statistics.hpp"
 #include "topology.hpp"
 #include "utils.hpp"
 #include "variant_visitors.hpp"
@@ -36,14 +40,17 @@
 #include <nlohmann/json.hpp>
 #include <sdbusplus/asio/connection.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/vtable.hpp>
 
 #include <charconv>
+#include <chrono>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
-#include <regex>
+#include <set>
 #include <variant>
 constexpr const char* hostConfigurationDirectory = SYSCONF_DIR "configurations";
 constexpr const char* configurationDirectory = PACKAGE_DIR "configurations";
@@ -62,6 +69,8 @@ constexpr auto fruIface = "xyz.openbmc_project.FruDevice";
 constexpr auto fruService = "xyz.openbmc_project.FruDevice";
 constexpr auto fwdPath = "fruDevice";
 constexpr auto revPath = "allFru";
+constexpr auto mapperService = "xyz.openbmc_project.ObjectMapper";
+constexpr auto endpointsIface = "xyz.openbmc_project.Association";
 const boost::container::flat_map<const char*, probe_type_codes, CmpStr>
     probeTypes{{{"FALSE", probe_type_codes::FALSE_T},
                 {"TRUE", probe_type_codes::TRUE_T},
@@ -89,9 +98,7 @@ using JsonVariantType =
 
 // NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
 // store reference to all interfaces so we can destroy them later
-boost::container::flat_map<
-    std::string, std::vector<std::weak_ptr<sdbusplus::asio::dbus_interface>>>
-    inventory;
+InterfaceRegistry<sdbusplus::asio::dbus_interface> inventory;
 
 using Interface = std::string;
 using UpdatableProperties = std::unordered_map<std::string, std::string>;
@@ -103,23 +110,66 @@ std::unordered_map<Interface, InterfaceProperties> probeDetails;
 // store record name to name
 std::unordered_map<std::string, std::string> nameToRecordName;
 
+// the endpoints of fruDevice associations by association path, as last read
+// from the mapper.  Entries are dropped when the mapper changes them, and a
+// read that was in flight across any change isn't kept.
+std::unordered_map<std::string, std::vector<std::string>> fruEndpoints;
+uint64_t fruEndpointsGeneration = 0;
+
+// the records published properties read their values from
+RecordBindings recordBindings;
+
+// the Exposes of systemConfiguration by Name, kept up to date as records are
+// added, changed or removed rather than rebuilt for each scan
+ExposeNameIndex exposeIndex;
+
 // todo: pass this through nicer
 std::shared_ptr<sdbusplus::asio::connection> systemBus;
 nlohmann::json lastJson;
 Topology topology;
+ScanStatistics scanStatistics;
 
 boost::asio::io_context io;
 // NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
 
-const std::regex illegalDbusPathRegex("[^A-Za-z0-9_.]");
-const std::regex illegalDbusMemberRegex("[^A-Za-z0-9_]");
+// longest publishing holds the io loop for before yielding to other work
+constexpr std::chrono::microseconds publishSliceBudget(PUBLISH_SLICE_BUDGET_US);
+
+// writes of the system configuration within this window are coalesced
+constexpr std::chrono::milliseconds persistWindow(PERSIST_WINDOW_MS);
+constexpr ConfigurationPersister::SyncPolicy persistSyncPolicy =
+    PERSIST_FSYNC ? ConfigurationPersister::SyncPolicy::always
+                  : ConfigurationPersister::SyncPolicy::never;
+constexpr ConfigurationPersister::Mode persistMode =
+    PERSIST_JOURNAL ? ConfigurationPersister::Mode::journal
+                    : ConfigurationPersister::Mode::snapshot;
+// how long journaled changes wait before they are compacted into the file
+constexpr std::chrono::seconds persistCompactInterval(
+    PERSIST_COMPACT_INTERVAL_S);
+
+// serialize the configuration on a worker thread rather than the io loop
+constexpr bool persistInBackground = PERSIST_THREAD;
+constexpr ConfigurationFormat persistFormat =
+    PERSIST_CBOR ? ConfigurationFormat::cbor : ConfigurationFormat::json;
+
+// publish the persisted configuration at startup, ahead of the first scan
+constexpr bool warmStart = WARM_START;
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+ConfigurationPersister persister(io, currentConfiguration, persistWindow,
+                                 persistSyncPolicy, persistMode,
+                                 persistCompactInterval, persistInBackground,
+                                 persistFormat);
 
 bool loadConfigurations(std::list<nlohmann::json>& configurations);
+// Interfaces are published under an object manager, so the InterfacesAdded
+// signal already carries every property.  Don't follow it up with a
+// PropertiesChanged per property.
 void tryIfaceInitialize(std::shared_ptr<sdbusplus::asio::dbus_interface>& iface)
 {
     try
     {
-        iface->initialize();
+        iface->initialize(true);
     }
     catch (std::exception& e)
     {
@@ -149,66 +199,48 @@ FoundProbeTypeT findProbeType(const std::string& probe)
 static std::shared_ptr<sdbusplus::asio::dbus_interface>
     createInterface(sdbusplus::asio::object_server& objServer,
                     const std::string& path, const std::string& interface,
-                    const std::string& parent, bool checkNull = false)
+                    const std::string& parent)
 {
-    // on first add we have no reason to check for null before add, as there
-    // won't be any. For dynamically added interfaces, we check for null so that
-    // a constant delete/add will not create a memory leak
-
+    // the registry reuses the slots of interfaces deleted at runtime, so a
+    // constant delete/add will not create a memory leak
     auto ptr = objServer.add_interface(path, interface);
-    auto& dataVector = inventory[parent];
-    if (checkNull)
-    {
-        auto it = std::find_if(dataVector.begin(), dataVector.end(),
-                               [](const auto& p) { return p.expired(); });
-        if (it != dataVector.end())
-        {
-            *it = ptr;
-            return ptr;
-        }
-    }
-    dataVector.emplace_back(ptr);
+    inventory.add(parent, ptr);
     return ptr;
 }
 
-// writes output files to persist data
-bool writeJsonFiles(const nlohmann::json& systemConfiguration)
+// schedules writing the output files to persist data.  The write happens
+// behind the caller's back, which logs it if it fails.
+void writeJsonFiles(const nlohmann::json& systemConfiguration)
 {
-    std::filesystem::create_directory(configurationOutDir);
-    std::ofstream output(currentConfiguration);
-    if (!output.good())
-    {
-        return false;
-    }
-    output << systemConfiguration.dump(4);
-    output.close();
-    return true;
+    persister.schedule(systemConfiguration);
 }
 
-template <typename JsonType>
-bool setJsonFromPointer(const std::string& ptrStr, const JsonType& value,
-                        nlohmann::json& systemConfiguration)
+// as writeJsonFiles, for a change to the value at jsonPointerString, which
+// in journal mode is appended to the journal instead.  The record holding the
+// value is indexed again, in case the change added, removed or renamed one of
+// its exposes.
+void writeJsonChange(const nlohmann::json& systemConfiguration,
+                     const std::string& jsonPointerString)
 {
-    try
+    nlohmann::json::json_pointer record(jsonPointerString);
+    while (!record.empty() && !record.parent_pointer().empty())
     {
-        nlohmann::json::json_pointer ptr(ptrStr);
-        nlohmann::json& ref = systemConfiguration[ptr];
-        ref = value;
-        return true;
+        record = record.parent_pointer();
     }
-    catch (const std::out_of_range&)
+    if (!record.empty())
     {
-        return false;
+        auto findRecord = systemConfiguration.find(record.back());
+        if (findRecord != systemConfiguration.end())
+        {
+            exposeIndex.addRecord(findRecord.key(), *findRecord);
+        }
     }
+
+    persister.recordChange(systemConfiguration, jsonPointerString);
 }
 
-// template function to add array as dbus property
 template <typename PropertyType>
-void addArrayToDbus(const std::string& name, const nlohmann::json& array,
-                    sdbusplus::asio::dbus_interface* iface,
-                    sdbusplus::asio::PropertyPermission permission,
-                    nlohmann::json& systemConfiguration,
-                    const std::string& jsonPointerString)
+std::vector<PropertyType> getArrayValues(const nlohmann::json& array)
 {
     std::vector<PropertyType> values;
     for (const auto& property : array)
@@ -219,33 +251,88 @@ void addArrayToDbus(const std::string& name, const nlohmann::json& array,
             values.emplace_back(*ptr);
         }
     }
+    return values;
+}
+
+// Reads the current value of a bound property as the type it was published
+// as.  A value that is gone, or is no longer of that type, reads as the
+// default of the type.
+template <typename PropertyType>
+PropertyType readBoundProperty(const nlohmann::json& systemConfiguration,
+                               const InterfaceBinding& binding,
+                               const std::string& name)
+{
+    const nlohmann::json* value = binding.find(systemConfiguration, name);
+    if (value == nullptr)
+    {
+        return {};
+    }
+    if constexpr (std::is_same_v<PropertyType, std::string> ||
+                  std::is_same_v<PropertyType, bool>)
+    {
+        const auto* ptr = value->get_ptr<const PropertyType*>();
+        return ptr == nullptr ? PropertyType{} : *ptr;
+    }
+    else
+    {
+        return value->is_number() ? value->get<PropertyType>()
+                                  : PropertyType{};
+    }
+}
+
+template <typename PropertyType>
+std::vector<PropertyType>
+    readBoundArray(const nlohmann::json& systemConfiguration,
+                   const InterfaceBinding& binding, const std::string& name)
+{
+    const nlohmann::json* value = binding.find(systemConfiguration, name);
+    if (value == nullptr || !value->is_array())
+    {
+        return {};
+    }
+    return getArrayValues<PropertyType>(*value);
+}
+
+// template function to add array as dbus property
+template <typename PropertyType>
+void addArrayToDbus(const std::string& name,
+                    sdbusplus::asio::dbus_interface* iface,
+                    sdbusplus::asio::PropertyPermission permission,
+                    nlohmann::json& systemConfiguration,
+                    const std::shared_ptr<const InterfaceBinding>& binding)
+{
+    const std::string& propertyName = internPropertyName(name);
+    auto getter = [&systemConfiguration, binding,
+                   &propertyName](const std::vector<PropertyType>&) {
+        return readBoundArray<PropertyType>(systemConfiguration, *binding,
+                                            propertyName);
+    };
 
     if (permission == sdbusplus::asio::PropertyPermission::readOnly)
     {
-        iface->register_property(name, values);
+        iface->register_property_r<std::vector<PropertyType>>(
+            name, {}, sdbusplus::vtable::property_::emits_change,
+            std::move(getter));
     }
     else
     {
-        iface->register_property(
-            name, values,
-            [&systemConfiguration,
-             jsonPointerString{std::string(jsonPointerString)}](
-                const std::vector<PropertyType>& newVal,
-                std::vector<PropertyType>& val) {
-            val = newVal;
-            if (!setJsonFromPointer(jsonPointerString, val,
-                                    systemConfiguration))
+        iface->register_property_rw<std::vector<PropertyType>>(
+            name, {}, sdbusplus::vtable::property_::emits_change,
+            [&systemConfiguration, binding, &propertyName,
+             iface](const std::vector<PropertyType>& newVal,
+                    std::vector<PropertyType>&) {
+            std::string jsonPointerString = binding->jsonPointer() + "/" +
+                                            propertyName;
+            if (!writeBoundProperty(systemConfiguration, jsonPointerString,
+                                    *iface, propertyName, newVal))
             {
                 std::cerr << "error setting json field\n";
                 return -1;
             }
-            if (!writeJsonFiles(systemConfiguration))
-            {
-                std::cerr << "error setting json file\n";
-                return -1;
-            }
+            writeJsonChange(systemConfiguration, jsonPointerString);
             return 1;
-        });
+        },
+            std::move(getter));
     }
 }
 
@@ -313,29 +400,27 @@ bool isPropertyUpdatable(const std::string& propertyName,
     return false;
 }
 
+void invalidateFruEndpoints(const std::string& associationPath)
+{
+    fruEndpoints.erase(associationPath);
+    fruEndpointsGeneration++;
+}
+
+// Sets the mapped property on every FRU the inventory object at path is
+// associated with.  The endpoints are only read from the mapper when they
+// aren't cached.
 template <typename PropertyType>
 bool persistProperty(const PropertyType& newVal, const std::string& path,
                      const std::string& fruProperty)
 {
     std::string objectPath = path + "/" + fwdPath;
-    std::vector<std::string> endPoints;
-    systemBus->async_method_call(
-        [objectPath, fruProperty,
-         newVal](const boost::system::error_code& ec,
-                 std::variant<std::decay_t<decltype(endPoints)>>(
-                     endPoints)) mutable {
-        if (ec)
-        {
-            std::cerr << "No Associated paths found for " << objectPath << "\n";
-            std::cerr << "Error Msg " << ec.message() << "\n";
-            return false;
-        }
-        std::vector<std::string> data =
-            std::get<std::vector<std::string>>(endPoints);
-        for (const auto& endPoint : data)
+    auto setEndPoints = [fruProperty,
+                         newVal](const std::vector<std::string>& endPoints) {
+        PropertyType value = newVal;
+        for (const auto& endPoint : endPoints)
         {
             if (!updatePropertyValue(fruService, endPoint, fruIface,
-                                     fruProperty, newVal))
+                                     fruProperty, value))
             {
                 std::cerr << "Error setting property " << fruProperty
                           << " in interface " << fruIface << "\n";
@@ -343,63 +428,92 @@ bool persistProperty(const PropertyType& newVal, const std::string& path,
             }
         }
         return true;
+    };
+
+    auto findEndPoints = fruEndpoints.find(objectPath);
+    if (findEndPoints != fruEndpoints.end())
+    {
+        return setEndPoints(findEndPoints->second);
+    }
+
+    systemBus->async_method_call(
+        [objectPath, setEndPoints, generation = fruEndpointsGeneration](
+            const boost::system::error_code& ec,
+            const std::variant<std::vector<std::string>>& endPoints) {
+        if (ec)
+        {
+            std::cerr << "No Associated paths found for " << objectPath << "\n";
+            std::cerr << "Error Msg " << ec.message() << "\n";
+            return false;
+        }
+        const auto& data = std::get<std::vector<std::string>>(endPoints);
+        if (generation == fruEndpointsGeneration)
+        {
+            fruEndpoints.insert_or_assign(objectPath, data);
+        }
+        return setEndPoints(data);
     },
-        "xyz.openbmc_project.ObjectMapper", objectPath,
-        "org.freedesktop.DBus.Properties", "Get",
-        "xyz.openbmc_project.Association", "endpoints");
+        mapperService, objectPath, "org.freedesktop.DBus.Properties", "Get",
+        endpointsIface, "endpoints");
 
     return true;
 }
 
 template <typename PropertyType>
-void addProperty(const std::string& name, const PropertyType& value,
+void addProperty(const std::string& name,
                  sdbusplus::asio::dbus_interface* iface,
                  nlohmann::json& systemConfiguration,
-                 const std::string& jsonPointerString,
+                 const std::shared_ptr<const InterfaceBinding>& binding,
                  sdbusplus::asio::PropertyPermission permission)
 {
+    const std::string& propertyName = internPropertyName(name);
+    auto getter = [&systemConfiguration, binding,
+                   &propertyName](const PropertyType&) {
+        return readBoundProperty<PropertyType>(systemConfiguration, *binding,
+                                               propertyName);
+    };
+
     if (permission == sdbusplus::asio::PropertyPermission::readOnly)
     {
-        iface->register_property(name, value);
+        iface->register_property_r<PropertyType>(
+            name, PropertyType{}, sdbusplus::vtable::property_::emits_change,
+            std::move(getter));
         return;
     }
-    iface->register_property(
-        name, value,
-        [name, &systemConfiguration,
-         jsonPointerString{std::string(jsonPointerString)},
-         iface](const PropertyType& newVal, PropertyType& val) {
+    iface->register_property_rw<PropertyType>(
+        name, PropertyType{}, sdbusplus::vtable::property_::emits_change,
+        [&systemConfiguration, binding, &propertyName,
+         iface](const PropertyType& newVal, PropertyType&) {
+        std::string jsonPointerString = binding->jsonPointer() + "/" +
+                                        propertyName;
         std::string mappedProp;
-        if (isPropertyUpdatable(name, jsonPointerString, mappedProp))
+        if (isPropertyUpdatable(propertyName, jsonPointerString, mappedProp))
         {
             return persistProperty(newVal, iface->get_object_path(), mappedProp)
                        ? 1
                        : -1;
         }
-        val = newVal;
-        if (!setJsonFromPointer(jsonPointerString, val, systemConfiguration))
+        if (!writeBoundProperty(systemConfiguration, jsonPointerString, *iface,
+                                propertyName, newVal))
         {
             std::cerr << "error setting json field\n";
             return -1;
         }
-        if (!writeJsonFiles(systemConfiguration))
-        {
-            std::cerr << "error setting json file\n";
-            return -1;
-        }
+        writeJsonChange(systemConfiguration, jsonPointerString);
         return 1;
-    });
+    },
+        std::move(getter));
 }
 
 void createDeleteObjectMethod(
-    const std::string& jsonPointerPath,
+    const std::shared_ptr<const InterfaceBinding>& binding,
     const std::shared_ptr<sdbusplus::asio::dbus_interface>& iface,
     sdbusplus::asio::object_server& objServer,
     nlohmann::json& systemConfiguration)
 {
     std::weak_ptr<sdbusplus::asio::dbus_interface> interface = iface;
-    iface->register_method("Delete",
-                           [&objServer, &systemConfiguration, interface,
-                            jsonPointerPath{std::string(jsonPointerPath)}]() {
+    iface->register_method("Delete", [&objServer, &systemConfiguration,
+                                      interface, binding]() {
         std::shared_ptr<sdbusplus::asio::dbus_interface> dbusInterface =
             interface.lock();
         if (!dbusInterface)
@@ -408,7 +522,8 @@ void createDeleteObjectMethod(
             // us
             throw DBusInternalError();
         }
-        nlohmann::json::json_pointer ptr(jsonPointerPath);
+        std::string jsonPointerString = binding->jsonPointer();
+        nlohmann::json::json_pointer ptr(jsonPointerString);
         systemConfiguration[ptr] = nullptr;
 
         // todo(james): dig through sdbusplus to find out why we can't
@@ -417,173 +532,209 @@ void createDeleteObjectMethod(
             objServer.remove_interface(dbusInterface);
         });
 
-        if (!writeJsonFiles(systemConfiguration))
-        {
-            std::cerr << "error setting json file\n";
-            throw DBusInternalError();
-        }
+        writeJsonChange(systemConfiguration, jsonPointerString);
     });
 }
 
-// adds simple json types to interface's properties
-void populateInterfaceFromJson(
-    nlohmann::json& systemConfiguration, const std::string& jsonPointerPath,
-    std::shared_ptr<sdbusplus::asio::dbus_interface>& iface,
-    nlohmann::json& dict, sdbusplus::asio::object_server& objServer,
-    sdbusplus::asio::PropertyPermission permission =
-        sdbusplus::asio::PropertyPermission::readOnly)
+static bool isHomogeneousArray(const nlohmann::json& array)
 {
-    for (const auto& [key, value] : dict.items())
-    {
-        auto type = value.type();
-        bool array = false;
+    nlohmann::json::value_t type = array.front().type();
+    return std::all_of(array.begin(), array.end(),
+                       [type](const nlohmann::json& item) {
+        return item.type() == type;
+    });
+}
 
-        if (key == "Parent_Chassis" ||
-            key == "xyz.openbmc_project.Association.Definitions")
+struct PropertyType
+{
+    nlohmann::json::value_t type;
+    bool array;
+
+    bool operator==(const PropertyType&) const = default;
+};
+
+// Works out the type a configuration value is published on D-Bus as, or
+// std::nullopt for values that aren't published as a property.
+static std::optional<PropertyType>
+    getPropertyType(const nlohmann::json& value,
+                    sdbusplus::asio::PropertyPermission permission)
+{
+    PropertyType propertyType{value.type(), false};
+    if (value.is_array())
+    {
+        if (value.empty() || !isHomogeneousArray(value))
         {
-            continue;
+            return std::nullopt;
         }
+        propertyType = {value[0].type(), true};
+    }
+    if (propertyType.type == nlohmann::json::value_t::object)
+    {
+        return std::nullopt; // handled elsewhere
+    }
+
+    // all setable numbers are doubles as it is difficult to always create a
+    // configuration file with all whole numbers as decimals i.e. 1.0
+    if (permission == sdbusplus::asio::PropertyPermission::readWrite &&
+        (propertyType.type == nlohmann::json::value_t::number_integer ||
+         propertyType.type == nlohmann::json::value_t::number_unsigned))
+    {
+        propertyType.type = nlohmann::json::value_t::number_float;
+    }
+    return propertyType;
+}
 
-        if (value.type() == nlohmann::json::value_t::array)
+static bool isPublishedKey(const std::string& key)
+{
+    return key != "Parent_Chassis" &&
+           key != "xyz.openbmc_project.Association.Definitions";
+}
+
+// adds a simple json type to an interface's properties
+static void
+    addJsonProperty(nlohmann::json& systemConfiguration,
+                    const std::shared_ptr<const InterfaceBinding>& binding,
+                    std::shared_ptr<sdbusplus::asio::dbus_interface>& iface,
+                    const std::string& key, const nlohmann::json& value,
+                    sdbusplus::asio::PropertyPermission permission)
+{
+    if (!isPublishedKey(key))
+    {
+        return;
+    }
+
+    if (value.is_array() && !value.empty() && !isHomogeneousArray(value))
+    {
+        std::cerr << "dbus format error" << value << "\n";
+        return;
+    }
+    std::optional<PropertyType> propertyType = getPropertyType(value,
+                                                               permission);
+    if (!propertyType)
+    {
+        return;
+    }
+    bool array = propertyType->array;
+
+    switch (propertyType->type)
+    {
+        case (nlohmann::json::value_t::boolean):
         {
-            array = true;
-            if (value.empty())
+            if (array)
             {
-                continue;
+                // todo: array of bool isn't detected correctly by
+                // sdbusplus, change it to numbers
+                addArrayToDbus<uint64_t>(key, iface.get(), permission,
+                                         systemConfiguration, binding);
             }
-            type = value[0].type();
-            bool isLegal = true;
-            for (const auto& arrayItem : value)
-            {
-                if (arrayItem.type() != type)
-                {
-                    isLegal = false;
-                    break;
-                }
-            }
-            if (!isLegal)
+
+            else
             {
-                std::cerr << "dbus format error" << value << "\n";
-                continue;
+                addProperty<bool>(key, iface.get(), systemConfiguration,
+                                  binding, permission);
             }
+            break;
         }
-        if (type == nlohmann::json::value_t::object)
+        case (nlohmann::json::value_t::number_integer):
         {
-            continue; // handled elsewhere
-        }
-
-        std::string path = jsonPointerPath;
-        path.append("/").append(key);
-        if (permission == sdbusplus::asio::PropertyPermission::readWrite)
-        {
-            // all setable numbers are doubles as it is difficult to always
-            // create a configuration file with all whole numbers as decimals
-            // i.e. 1.0
             if (array)
             {
-                if (value[0].is_number())
-                {
-                    type = nlohmann::json::value_t::number_float;
-                }
+                addArrayToDbus<int64_t>(key, iface.get(), permission,
+                                        systemConfiguration, binding);
             }
-            else if (value.is_number())
+            else
             {
-                type = nlohmann::json::value_t::number_float;
+                addProperty<int64_t>(
+                    key, iface.get(), systemConfiguration, binding,
+                    sdbusplus::asio::PropertyPermission::readOnly);
             }
+            break;
         }
-
-        switch (type)
+        case (nlohmann::json::value_t::number_unsigned):
         {
-            case (nlohmann::json::value_t::boolean):
+            if (array)
             {
-                if (array)
-                {
-                    // todo: array of bool isn't detected correctly by
-                    // sdbusplus, change it to numbers
-                    addArrayToDbus<uint64_t>(key, value, iface.get(),
-                                             permission, systemConfiguration,
-                                             path);
-                }
-
-                else
-                {
-                    addProperty(key, value.get<bool>(), iface.get(),
-                                systemConfiguration, path, permission);
-                }
-                break;
+                addArrayToDbus<uint64_t>(key, iface.get(), permission,
+                                         systemConfiguration, binding);
             }
-            case (nlohmann::json::value_t::number_integer):
+            else
             {
-                if (array)
-                {
-                    addArrayToDbus<int64_t>(key, value, iface.get(), permission,
-                                            systemConfiguration, path);
-                }
-                else
-                {
-                    addProperty(key, value.get<int64_t>(), iface.get(),
-                                systemConfiguration, path,
-                                sdbusplus::asio::PropertyPermission::readOnly);
-                }
-                break;
+                addProperty<uint64_t>(
+                    key, iface.get(), systemConfiguration, binding,
+                    sdbusplus::asio::PropertyPermission::readOnly);
             }
-            case (nlohmann::json::value_t::number_unsigned):
+            break;
+        }
+        case (nlohmann::json::value_t::number_float):
+        {
+            if (array)
             {
-                if (array)
-                {
-                    addArrayToDbus<uint64_t>(key, value, iface.get(),
-                                             permission, systemConfiguration,
-                                             path);
-                }
-                else
-                {
-                    addProperty(key, value.get<uint64_t>(), iface.get(),
-                                systemConfiguration, path,
-                                sdbusplus::asio::PropertyPermission::readOnly);
-                }
-                break;
+                addArrayToDbus<double>(key, iface.get(), permission,
+                                       systemConfiguration, binding);
             }
-            case (nlohmann::json::value_t::number_float):
-            {
-                if (array)
-                {
-                    addArrayToDbus<double>(key, value, iface.get(), permission,
-                                           systemConfiguration, path);
-                }
 
-                else
-                {
-                    addProperty(key, value.get<double>(), iface.get(),
-                                systemConfiguration, path, permission);
-                }
-                break;
+            else
+            {
+                addProperty<double>(key, iface.get(), systemConfiguration,
+                                    binding, permission);
             }
-            case (nlohmann::json::value_t::string):
+            break;
+        }
+        case (nlohmann::json::value_t::string):
+        {
+            if (array)
             {
-                if (array)
-                {
-                    addArrayToDbus<std::string>(key, value, iface.get(),
-                                                permission, systemConfiguration,
-                                                path);
-                }
-                else
-                {
-                    addProperty(key, value.get<std::string>(), iface.get(),
-                                systemConfiguration, path, permission);
-                }
-                break;
+                addArrayToDbus<std::string>(key, iface.get(), permission,
+                                            systemConfiguration, binding);
             }
-            default:
+            else
             {
-                std::cerr << "Unexpected json type in system configuration "
-                          << key << ": " << value.type_name() << "\n";
-                break;
+                addProperty<std::string>(key, iface.get(), systemConfiguration,
+                                         binding, permission);
             }
+            break;
+        }
+        default:
+        {
+            std::cerr << "Unexpected json type in system configuration "
+                      << key << ": " << value.type_name() << "\n";
+            break;
+        }
+    }
+}
+
+// adds simple json types to interface's properties, with the entries of
+// overrides taking the place of those of the same key in dict.  The
+// properties read their values through binding, which has to lead to dict.
+void populateInterfaceFromJson(
+    nlohmann::json& systemConfiguration,
+    const std::shared_ptr<const InterfaceBinding>& binding,
+    std::shared_ptr<sdbusplus::asio::dbus_interface>& iface,
+    const nlohmann::json& dict, sdbusplus::asio::object_server& objServer,
+    sdbusplus::asio::PropertyPermission permission =
+        sdbusplus::asio::PropertyPermission::readOnly,
+    const nlohmann::json* overrides = nullptr)
+{
+    if (overrides != nullptr)
+    {
+        for (const auto& [key, value] : overrides->items())
+        {
+            addJsonProperty(systemConfiguration, binding, iface, key, value,
+                            permission);
+        }
+    }
+    for (const auto& [key, value] : dict.items())
+    {
+        if (overrides != nullptr && overrides->contains(key))
+        {
+            continue;
         }
+        addJsonProperty(systemConfiguration, binding, iface, key, value,
+                        permission);
     }
     if (permission == sdbusplus::asio::PropertyPermission::readWrite)
     {
-        createDeleteObjectMethod(jsonPointerPath, iface, objServer,
+        createDeleteObjectMethod(binding, iface, objServer,
                                  systemConfiguration);
     }
     tryIfaceInitialize(iface);
@@ -692,26 +843,21 @@ void createAddObjectMethod(const std::string& jsonPointerPath,
         {
             findExposes->push_back(newData);
         }
-        if (!writeJsonFiles(systemConfiguration))
-        {
-            std::cerr << "Error writing json files\n";
-            throw DBusInternalError();
-        }
-        std::string dbusName = *name;
-
-        std::regex_replace(dbusName.begin(), dbusName.begin(), dbusName.end(),
-                           illegalDbusMemberRegex, "_");
+        writeJsonChange(systemConfiguration, jsonPointerPath + "/Exposes/" +
+                                                 std::to_string(lastIndex));
+        std::string dbusName = sanitizeDbusName(*name);
 
         std::shared_ptr<sdbusplus::asio::dbus_interface> interface =
             createInterface(objServer, path + "/" + dbusName,
-                            "xyz.openbmc_project.Configuration." + *type, board,
-                            true);
+                            "xyz.openbmc_project.Configuration." + *type,
+                            board);
         // permission is read-write, as since we just created it, must be
         // runtime modifiable
+        auto binding = std::make_shared<const InterfaceBinding>(
+            recordBindings.get(jsonPointerPath.substr(1)),
+            "/Exposes/" + std::to_string(lastIndex));
         populateInterfaceFromJson(
-            systemConfiguration,
-            jsonPointerPath + "/Exposes/" + std::to_string(lastIndex),
-            interface, newData, objServer,
+            systemConfiguration, binding, interface, newData, objServer,
             sdbusplus::asio::PropertyPermission::readWrite);
     });
     tryIfaceInitialize(iface);
@@ -799,360 +945,815 @@ void scanUpdatableData()
 
 using Association = std::tuple<std::string, std::string, std::string>;
 
-void postToDbus(const nlohmann::json& newConfiguration,
-                nlohmann::json& systemConfiguration,
-                sdbusplus::asio::object_server& objServer)
+// An interface carrying properties of a record, as postToDbus publishes it.
+struct InterfaceLayout
+{
+    std::string path;
+    std::string interface;
+    // location of the properties, relative to the record
+    std::string pointer;
+    sdbusplus::asio::PropertyPermission permission;
+    // views into the record, which outlives the layout
+    const nlohmann::json* properties;
+    // entries taking the place of those of the same key in properties
+    const nlohmann::json* overrides;
+};
+
+// Everything postToDbus publishes for a record.
+struct BoardLayout
+{
+    std::string path;
+    std::string type;
+    std::string name;
+    // the name as it appears in the object path
+    std::string dbusName;
+    std::string recordName;
+    std::string jsonPointer;
+    std::vector<InterfaceLayout> interfaces;
+    std::vector<Association> associations;
+    std::vector<const nlohmann::json*> topologyItems;
+};
+
+// A record that replaces one of the same name, published by reconciling its
+// interfaces with those of the record it replaces.
+struct ReplacedRecord
+{
+    std::string oldName;
+    nlohmann::json oldRecord;
+    std::string newName;
+};
 
+static bool isPublishedProperty(const std::string& key,
+                                const nlohmann::json& value)
 {
-    // Writable interfaces and mapped property are scanned only once
-    if (!dataUpdated)
-    {
-        scanUpdatableData();
-    }
+    return isPublishedKey(key) && !value.is_object() &&
+           !(value.is_array() && !value.empty() && value[0].is_object());
+}
 
-    // these details are used to get mapped property or to get updatable
-    // interface
-    for (const auto& boardPair : newConfiguration.items())
+// Calls callback(key, value) for each property an interface layout publishes.
+template <typename Callback>
+static void forEachProperty(const InterfaceLayout& layout, Callback&& callback)
+{
+    if (layout.overrides != nullptr)
     {
-        std::string boardKey = boardPair.value()["Name"];
-
-        for (auto& record : nameToRecordName)
+        for (auto it = layout.overrides->begin(); it != layout.overrides->end();
+             it++)
         {
-            if (record.second == boardKey)
+            if (isPublishedProperty(it.key(), *it))
             {
-                nameToRecordName.erase(record.first);
-                break;
+                callback(it.key(), *it);
             }
         }
-        nameToRecordName.emplace(boardPair.key(), boardKey);
     }
-    Topology topology;
-    std::map<std::string, std::string> newBoards; // path -> name
-
-    // iterate through boards
-    for (const auto& [boardId, boardConfig] : newConfiguration.items())
+    for (auto it = layout.properties->begin(); it != layout.properties->end();
+         it++)
     {
-        std::string boardName = boardConfig["Name"];
-        std::string boardNameOrig = boardConfig["Name"];
-        std::string jsonPointerPath = "/" + boardId;
-        // loop through newConfiguration, but use values from system
-        // configuration to be able to modify via dbus later
-        auto boardValues = systemConfiguration[boardId];
-        auto findBoardType = boardValues.find("Type");
-        auto findBoardParent = boardValues.find("Parent_Chassis");
-        auto findCustomNameEnabled = boardValues.find("Custom_Name");
-        std::string boardType;
-        if (findBoardType != boardValues.end() &&
-            findBoardType->type() == nlohmann::json::value_t::string)
-        {
-            boardType = findBoardType->get<std::string>();
-            std::regex_replace(boardType.begin(), boardType.begin(),
-                               boardType.end(), illegalDbusMemberRegex, "_");
-        }
-        else
+        if ((layout.overrides == nullptr ||
+             !layout.overrides->contains(it.key())) &&
+            isPublishedProperty(it.key(), *it))
         {
-            std::cerr << "Unable to find type for " << boardName
-                      << " reverting to Chassis.\n";
-            boardType = "Chassis";
+            callback(it.key(), *it);
         }
-        std::string boardtypeLower = boost::algorithm::to_lower_copy(boardType);
+    }
+}
 
-        bool customNameEnabled = false;
-        if (findCustomNameEnabled != boardValues.end() &&
-            findCustomNameEnabled->type() == nlohmann::json::value_t::boolean)
+static const nlohmann::json* findProperty(const InterfaceLayout& layout,
+                                          const std::string& key)
+{
+    for (const nlohmann::json* dict : {layout.overrides, layout.properties})
+    {
+        if (dict == nullptr)
         {
-            customNameEnabled = findCustomNameEnabled->get<bool>();
-            std::clog << "Using custom name  " << boardName
-                      << " for dbus object.\n";
+            continue;
         }
-
-        if (!customNameEnabled)
+        auto findKey = dict->find(key);
+        if (findKey != dict->end())
         {
-            std::regex_replace(boardName.begin(), boardName.begin(),
-                               boardName.end(), illegalDbusMemberRegex, "_");
+            return isPublishedProperty(key, *findKey) ? &*findKey : nullptr;
         }
-        std::string boardPath = "/xyz/openbmc_project/inventory/system/";
-        boardPath += boardtypeLower;
-        boardPath += "/";
-        boardPath += boardName;
+    }
+    return nullptr;
+}
+
+static size_t countProperties(const InterfaceLayout& layout)
+{
+    size_t count = 0;
+    forEachProperty(layout, [&count](const std::string&,
+                                     const nlohmann::json&) { count++; });
+    return count;
+}
+
+static bool samePublishedProperties(const InterfaceLayout& oldLayout,
+                                    const InterfaceLayout& newLayout)
+{
+    bool same = true;
+    forEachProperty(newLayout, [&oldLayout,
+                                &same](const std::string& key,
+                                       const nlohmann::json& value) {
+        const nlohmann::json* oldValue = findProperty(oldLayout, key);
+        same = same && oldValue != nullptr && *oldValue == value;
+    });
+    return same && countProperties(oldLayout) == countProperties(newLayout);
+}
+
+static BoardLayout layoutBoard(const std::string& boardId,
+                               const nlohmann::json& board)
+{
+    BoardLayout layout;
+    layout.name = board["Name"];
+    layout.dbusName = layout.name;
+    layout.recordName = boardId;
+    layout.jsonPointer = "/" + boardId;
+
+    // the layout views the record in place, values are only copied when they
+    // are registered as properties
+    auto findBoardType = board.find("Type");
+    auto findBoardParent = board.find("Parent_Chassis");
+    auto findCustomNameEnabled = board.find("Custom_Name");
+    if (findBoardType != board.end() &&
+        findBoardType->type() == nlohmann::json::value_t::string)
+    {
+        layout.type =
+            sanitizeDbusName(findBoardType->get_ref<const std::string&>());
+    }
+    else
+    {
+        std::cerr << "Unable to find type for " << layout.name
+                  << " reverting to Chassis.\n";
+        layout.type = "Chassis";
+    }
+    std::string boardtypeLower = boost::algorithm::to_lower_copy(layout.type);
+
+    bool customNameEnabled = false;
+    if (findCustomNameEnabled != board.end() &&
+        findCustomNameEnabled->type() == nlohmann::json::value_t::boolean)
+    {
+        customNameEnabled = findCustomNameEnabled->get<bool>();
+        std::clog << "Using custom name  " << layout.name
+                  << " for dbus object.\n";
+    }
 
-        std::shared_ptr<sdbusplus::asio::dbus_interface> inventoryIface =
-            createInterface(objServer, boardPath,
-                            "xyz.openbmc_project.Inventory.Item", boardName);
+    if (!customNameEnabled)
+    {
+        layout.dbusName = sanitizeDbusName(layout.dbusName);
+    }
+    layout.path = "/xyz/openbmc_project/inventory/system/";
+    layout.path += boardtypeLower;
+    layout.path += "/";
+    layout.path += layout.dbusName;
+
+    // properties of the BoardIface == PropIface object are published on the
+    // board interface, in place of board properties of the same name
+    std::string boardIname = "xyz.openbmc_project.Inventory.Item." +
+                             layout.type;
+    const nlohmann::json* boardOverrides = nullptr;
+    auto findBoardIface = board.find(boardIname);
+    if (findBoardIface != board.end() && findBoardIface->is_object())
+    {
+        boardOverrides = &*findBoardIface;
+    }
 
-        std::string boardIname = "xyz.openbmc_project.Inventory.Item." +
-                                 boardType;
-        std::shared_ptr<sdbusplus::asio::dbus_interface> boardIface =
-            createInterface(objServer, boardPath, boardIname, boardNameOrig);
+    // pointers are built in place in one buffer, relative to the record
+    std::string jsonPointerPath;
+    jsonPointerPath.reserve(64);
+    auto addInterface = [&layout,
+                         &jsonPointerPath](const std::string& path,
+                                           std::string interface,
+                                           sdbusplus::asio::PropertyPermission
+                                               permission,
+                                           const nlohmann::json& properties,
+                                           const nlohmann::json* overrides) {
+        layout.interfaces.push_back({path, std::move(interface),
+                                     jsonPointerPath, permission, &properties,
+                                     overrides});
+    };
+
+    addInterface(layout.path, boardIname,
+                 sdbusplus::asio::PropertyPermission::readOnly, board,
+                 boardOverrides);
+    if (findBoardParent != board.end() &&
+        findBoardParent->type() == nlohmann::json::value_t::string)
+    {
+        std::string boardParent = findBoardParent->get<std::string>();
+        layout.associations.emplace_back("parent_chassis", "all_chassis",
+                                         boardParent);
+    }
 
-        createAddObjectMethod(jsonPointerPath, boardPath, systemConfiguration,
-                              objServer, boardNameOrig);
-        // iterate through board properties to match up BoardIface == PropIface
-        for (const auto& [propName, propValue] : boardValues.items())
+    // iterate through board properties
+    for (const auto& [propName, propValue] : board.items())
+    {
+        if (propValue.type() == nlohmann::json::value_t::object)
         {
-            if (propValue.type() == nlohmann::json::value_t::object)
+            if (propName == "xyz.openbmc_project.Association.Definitions")
             {
-                if (propName == boardIname)
+                for (const auto& [key, value] : propValue.items())
                 {
-                    for (const auto& [key, value] : propValue.items())
+                    if (key == "Associations" &&
+                        value.type() == nlohmann::json::value_t::array)
                     {
-                        if (boardValues.contains(key))
+                        for (const auto& arr : value)
                         {
-                            boardValues[key] = value;
-                        }
-                        else
-                        {
-                            boardValues.update(propValue, true);
+                            if (arr.is_array() && arr.size() == 3)
+                            {
+                                layout.associations.emplace_back(
+                                    arr[0].get<std::string>(),
+                                    arr[1].get<std::string>(),
+                                    arr[2].get<std::string>());
+                            }
+                            else
+                            {
+                                std::cerr
+                                    << "Error: Association requires {forward, backward and path} \n";
+                            }
                         }
                     }
                 }
             }
+            else
+            {
+                jsonPointerPath.assign("/").append(propName);
+                addInterface(layout.path, propName, getPermission(propName),
+                             propValue, nullptr);
+            }
+        }
+        if (propName == probePath)
+        {
+            // Creating association between the entity manager object
+            // path and probe Path(FRU Path)
+            layout.associations.emplace_back(fwdPath, revPath, propValue);
+        }
+    }
+
+    auto exposes = board.find("Exposes");
+    if (exposes == board.end())
+    {
+        return layout;
+    }
+
+    std::string ifacePath;
+    size_t exposesIndex = -1;
+    for (const auto& item : *exposes)
+    {
+        exposesIndex++;
+        jsonPointerPath.assign("/Exposes/").append(
+            std::to_string(exposesIndex));
+        // store the item level pointer so we can extend it on the way down
+        size_t itemPointerSize = jsonPointerPath.size();
+
+        auto findName = item.find("Name");
+        if (findName == item.end())
+        {
+            std::cerr << "cannot find name in field " << item << "\n";
+            continue;
+        }
+        auto findStatus = item.find("Status");
+        // if status is not found it is assumed to be status = 'okay'
+        if (findStatus != item.end())
+        {
+            if (*findStatus == "disabled")
+            {
+                continue;
+            }
         }
+        auto findType = item.find("Type");
+        std::string itemType;
+        if (findType != item.end())
+        {
+            itemType = sanitizeDbusName(findType->get<std::string>(), true);
+        }
+        else
+        {
+            itemType = "unknown";
+        }
+        ifacePath = layout.path;
+        ifacePath += "/";
+        ifacePath += sanitizeDbusName(findName->get<std::string>());
 
-        populateInterfaceFromJson(systemConfiguration, jsonPointerPath,
-                                  boardIface, boardValues, objServer);
-        std::vector<Association> associations;
-        if (findBoardParent != boardValues.end() &&
-            findBoardParent->type() == nlohmann::json::value_t::string)
+        if (itemType == "BMC")
+        {
+            addInterface(ifacePath, "xyz.openbmc_project.Inventory.Item.Bmc",
+                         getPermission(itemType), item, nullptr);
+        }
+        else if (itemType == "System")
         {
-            std::string boardParent = findBoardParent->get<std::string>();
-            associations.emplace_back("parent_chassis", "all_chassis",
-                                      boardParent);
+            addInterface(ifacePath, "xyz.openbmc_project.Inventory.Item.System",
+                         getPermission(itemType), item, nullptr);
         }
 
-        jsonPointerPath += "/";
-        // iterate through board properties
-        for (const auto& [propName, propValue] : boardValues.items())
+        addInterface(ifacePath, "xyz.openbmc_project.Configuration." + itemType,
+                     getPermission(itemType), item, nullptr);
+
+        for (const auto& [name, config] : item.items())
         {
-            if (propValue.type() == nlohmann::json::value_t::object)
+            jsonPointerPath.resize(itemPointerSize);
+            jsonPointerPath.append("/").append(name);
+            if (config.type() == nlohmann::json::value_t::object)
             {
-                if (propName == "xyz.openbmc_project.Association.Definitions")
+                std::string ifaceName = "xyz.openbmc_project.Configuration.";
+                ifaceName.append(itemType).append(".").append(name);
+
+                addInterface(ifacePath, std::move(ifaceName),
+                             getPermission(name), config, nullptr);
+            }
+            else if (config.type() == nlohmann::json::value_t::array)
+            {
+                size_t index = 0;
+                if (config.empty())
                 {
-                    for (const auto& [key, value] : propValue.items())
-                    {
-                        if (key == "Associations" &&
-                            value.type() == nlohmann::json::value_t::array)
-                        {
-                            for (const auto& arr : value)
-                            {
-                                if (arr.is_array() && arr.size() == 3)
-                                {
-                                    associations.emplace_back(
-                                        arr[0].get<std::string>(),
-                                        arr[1].get<std::string>(),
-                                        arr[2].get<std::string>());
-                                }
-                                else
-                                {
-                                    std::cerr
-                                        << "Error: Association requires {forward, backward and path} \n";
-                                }
-                            }
-                        }
-                    }
+                    continue;
                 }
-                else
+                auto type = config[0].type();
+                if (type != nlohmann::json::value_t::object)
                 {
-                    std::shared_ptr<sdbusplus::asio::dbus_interface> iface =
-                        createInterface(objServer, boardPath, propName,
-                                        boardNameOrig);
+                    continue;
+                }
 
-                    populateInterfaceFromJson(
-                        systemConfiguration, jsonPointerPath + propName, iface,
-                        propValue, objServer, getPermission(propName));
+                // verify legal json
+                if (!isHomogeneousArray(config))
+                {
+                    std::cerr << "dbus format error" << config << "\n";
+                    break;
+                }
+
+                size_t configPointerSize = jsonPointerPath.size();
+                for (const auto& arrayItem : config)
+                {
+                    std::string ifaceName =
+                        "xyz.openbmc_project.Configuration.";
+                    ifaceName.append(itemType).append(".").append(name);
+                    ifaceName.append(std::to_string(index));
+
+                    jsonPointerPath.resize(configPointerSize);
+                    jsonPointerPath.append("/").append(std::to_string(index));
+                    addInterface(ifacePath, std::move(ifaceName),
+                                 getPermission(name), arrayItem, nullptr);
+                    index++;
                 }
             }
-            if (propName == probePath)
+        }
+
+        layout.topologyItems.push_back(&item);
+    }
+    return layout;
+}
+
+static void publishInterface(nlohmann::json& systemConfiguration,
+                             sdbusplus::asio::object_server& objServer,
+                             const BoardLayout& board,
+                             const InterfaceLayout& layout)
+{
+    std::shared_ptr<sdbusplus::asio::dbus_interface> iface =
+        createInterface(objServer, layout.path, layout.interface, board.name);
+    // the only overrides are those of the board interface, which are keyed by
+    // the interface name
+    auto binding = std::make_shared<const InterfaceBinding>(
+        recordBindings.get(board.recordName), layout.pointer,
+        layout.overrides != nullptr ? layout.interface : std::string());
+    populateInterfaceFromJson(systemConfiguration, binding, iface,
+                              *layout.properties, objServer, layout.permission,
+                              layout.overrides);
+}
+
+static void publishAssociations(sdbusplus::asio::object_server& objServer,
+                                const BoardLayout& board)
+{
+    if (board.associations.empty())
+    {
+        return;
+    }
+    std::shared_ptr<sdbusplus::asio::dbus_interface> parentIface =
+        createInterface(objServer, board.path, association::interface,
+                        board.name);
+    parentIface->register_property(
+        "Associations", board.associations,
+        sdbusplus::asio::PropertyPermission::readWrite);
+    parentIface->initialize(true);
+}
+
+static void publishBoard(nlohmann::json& systemConfiguration,
+                         sdbusplus::asio::object_server& objServer,
+                         const BoardLayout& board)
+{
+    createInterface(objServer, board.path, "xyz.openbmc_project.Inventory.Item",
+                    board.dbusName);
+    createAddObjectMethod(board.jsonPointer, board.path, systemConfiguration,
+                          objServer, board.name);
+    for (const InterfaceLayout& layout : board.interfaces)
+    {
+        publishInterface(systemConfiguration, objServer, board, layout);
+    }
+    publishAssociations(objServer, board);
+}
+
+// Brings a published interface from oldLayout to newLayout.  The properties
+// already read the new values through their binding, so this only signals the
+// ones that changed.  Only possible when both publish the same properties with
+// the same types from the same place in the record.
+static bool updateInterface(sdbusplus::asio::dbus_interface& iface,
+                            const InterfaceLayout& oldLayout,
+                            const InterfaceLayout& newLayout)
+{
+    if (oldLayout.permission != newLayout.permission ||
+        oldLayout.pointer != newLayout.pointer ||
+        (oldLayout.overrides == nullptr) != (newLayout.overrides == nullptr) ||
+        countProperties(oldLayout) != countProperties(newLayout))
+    {
+        return false;
+    }
+
+    bool compatible = true;
+    std::vector<const std::string*> changed;
+    forEachProperty(newLayout, [&oldLayout, &newLayout, &compatible,
+                                &changed](const std::string& key,
+                                          const nlohmann::json& value) {
+        const nlohmann::json* oldValue = findProperty(oldLayout, key);
+        if (oldValue == nullptr)
+        {
+            compatible = false;
+            return;
+        }
+        std::optional<PropertyType> propertyType =
+            getPropertyType(value, newLayout.permission);
+        if (propertyType != getPropertyType(*oldValue, oldLayout.permission))
+        {
+            compatible = false;
+            return;
+        }
+        if (propertyType && *oldValue != value)
+        {
+            changed.push_back(&key);
+        }
+    });
+    if (!compatible)
+    {
+        return false;
+    }
+
+    for (const std::string* key : changed)
+    {
+        iface.signal_property(*key);
+    }
+    return true;
+}
+
+// Publishes newBoard in place of oldBoard, touching only the interfaces that
+// differ between the two.  Returns true if the board's associations were
+// republished, in which case its topology associations have to be as well.
+static bool reconcileBoard(nlohmann::json& systemConfiguration,
+                           sdbusplus::asio::object_server& objServer,
+                           const BoardLayout& oldBoard,
+                           const BoardLayout& newBoard)
+{
+    auto boardId = inventory.intern(newBoard.name);
+    if (oldBoard.path != newBoard.path)
+    {
+        inventory.removeBoard(boardId, [&objServer](const auto& iface) {
+            objServer.remove_interface(iface);
+        });
+        publishBoard(systemConfiguration, objServer, newBoard);
+        return true;
+    }
+
+    using Key = std::pair<std::string, std::string>;
+    std::map<Key, std::vector<std::shared_ptr<sdbusplus::asio::dbus_interface>>>
+        published;
+    inventory.forEach(boardId, [&published](const auto& iface) {
+        published[{iface->get_object_path(), iface->get_interface_name()}]
+            .push_back(iface);
+    });
+    auto unpublish = [&objServer, &published](const Key& key) {
+        auto findIfaces = published.find(key);
+        if (findIfaces == published.end())
+        {
+            return;
+        }
+        for (const auto& iface : findIfaces->second)
+        {
+            objServer.remove_interface(iface);
+        }
+        published.erase(findIfaces);
+    };
+
+    std::map<Key, const InterfaceLayout*> oldInterfaces;
+    for (const InterfaceLayout& layout : oldBoard.interfaces)
+    {
+        oldInterfaces.try_emplace({layout.path, layout.interface}, &layout);
+    }
+
+    for (const InterfaceLayout& layout : newBoard.interfaces)
+    {
+        Key key{layout.path, layout.interface};
+        auto findOld = oldInterfaces.find(key);
+        if (findOld != oldInterfaces.end())
+        {
+            const InterfaceLayout& oldLayout = *findOld->second;
+            oldInterfaces.erase(findOld);
+
+            auto findIface = published.find(key);
+            if (findIface != published.end() && findIface->second.size() == 1)
             {
-                // Creating association between the entity manager object
-                // path and probe Path(FRU Path)
-                associations.emplace_back(fwdPath, revPath, propValue);
+                // the properties are bound to where they are in the record
+                bool unchanged = oldLayout.permission == layout.permission &&
+                                 oldLayout.pointer == layout.pointer &&
+                                 (oldLayout.overrides == nullptr) ==
+                                     (layout.overrides == nullptr) &&
+                                 samePublishedProperties(oldLayout, layout);
+                if (unchanged ||
+                    updateInterface(*findIface->second.front(), oldLayout,
+                                    layout))
+                {
+                    continue;
+                }
             }
         }
+        unpublish(key);
+        publishInterface(systemConfiguration, objServer, newBoard, layout);
+    }
+    for (const auto& [key, _] : oldInterfaces)
+    {
+        unpublish(key);
+    }
+
+    // the method writes to the record under its name
+    if (oldBoard.jsonPointer != newBoard.jsonPointer)
+    {
+        unpublish({newBoard.path, "xyz.openbmc_project.AddObject"});
+        createAddObjectMethod(newBoard.jsonPointer, newBoard.path,
+                              systemConfiguration, objServer, newBoard.name);
+    }
+
+    inventory.sweep(boardId);
+
+    if (oldBoard.associations == newBoard.associations &&
+        std::equal(oldBoard.topologyItems.begin(), oldBoard.topologyItems.end(),
+                   newBoard.topologyItems.begin(), newBoard.topologyItems.end(),
+                   [](const nlohmann::json* oldItem,
+                      const nlohmann::json* newItem) {
+        return *oldItem == *newItem;
+    }))
+    {
+        return false;
+    }
+    unpublish({newBoard.path, association::interface});
+    publishAssociations(objServer, newBoard);
+    return true;
+}
+
+static void mapRecordName(const std::string& recordName,
+                          const nlohmann::json& record)
+{
+    std::string boardKey = record["Name"];
+
+    for (auto& entry : nameToRecordName)
+    {
+        if (entry.second == boardKey)
+        {
+            nameToRecordName.erase(entry.first);
+            break;
+        }
+    }
+    nameToRecordName.emplace(recordName, boardKey);
+}
+
+// A batch of records being published, a slice at a time.
+struct PublishJob
+{
+    nlohmann::json newConfiguration;
+    std::vector<ReplacedRecord> replacedRecords;
+    std::function<void()> done;
+
+    bool started = false;
+    nlohmann::json::const_iterator nextNew;
+    size_t nextReplaced = 0;
+    // boards whose associations were (re)published, path -> name
+    std::map<std::string, std::string> newBoards;
+};
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static std::deque<std::shared_ptr<PublishJob>> publishQueue;
+// the interfaces publishing each board's topology associations, by path
+static std::unordered_map<
+    std::string, InterfaceRegistry<sdbusplus::asio::dbus_interface>::Handle>
+    topologyInterfaces;
+// records published from the persisted configuration at startup that no scan
+// has accounted for yet
+static std::set<std::string> provisionalRecords;
+// carries the Provisional property, set until scans have reconciled all of
+// those records
+static std::shared_ptr<sdbusplus::asio::dbus_interface> entityIface;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+static void startPublishJob(const nlohmann::json& systemConfiguration,
+                            PublishJob& job)
+{
+    job.started = true;
+    job.nextNew = job.newConfiguration.cbegin();
+
+    // Writable interfaces and mapped property are scanned only once
+    if (!dataUpdated)
+    {
+        scanUpdatableData();
+    }
+
+    // these details are used to get mapped property or to get updatable
+    // interface
+    for (const auto& boardPair : job.newConfiguration.items())
+    {
+        mapRecordName(boardPair.key(), boardPair.value());
+    }
+    for (const ReplacedRecord& replaced : job.replacedRecords)
+    {
+        auto findRecord = systemConfiguration.find(replaced.newName);
+        if (findRecord != systemConfiguration.end())
+        {
+            mapRecordName(replaced.newName, *findRecord);
+        }
+    }
+}
 
-        if (!associations.empty())
+// Publishes the next record of the job.  Records that were pruned since the
+// job was queued are skipped.  Returns false once there are none left.
+static bool publishNextRecord(nlohmann::json& systemConfiguration,
+                              sdbusplus::asio::object_server& objServer,
+                              PublishJob& job)
+{
+    if (job.nextNew != job.newConfiguration.cend())
+    {
+        const std::string& boardId = job.nextNew.key();
+        job.nextNew++;
+        auto findRecord = systemConfiguration.find(boardId);
+        if (findRecord == systemConfiguration.end())
         {
-            std::shared_ptr<sdbusplus::asio::dbus_interface> parentIface =
-                createInterface(objServer, boardPath, association::interface,
-                                boardNameOrig);
-            parentIface->register_property(
-                "Associations", associations,
-                sdbusplus::asio::PropertyPermission::readWrite);
-            parentIface->initialize();
+            return true;
         }
+        BoardLayout board = layoutBoard(boardId, *findRecord);
+        publishBoard(systemConfiguration, objServer, board);
 
-        auto exposes = boardValues.find("Exposes");
-        if (exposes == boardValues.end())
+        for (const nlohmann::json* item : board.topologyItems)
         {
-            continue;
+            topology.addBoard(board.path, board.type, board.name, *item);
         }
-        // iterate through exposes
-        jsonPointerPath += "Exposes/";
+        job.newBoards.emplace(board.path, board.name);
+        return true;
+    }
 
-        // store the board level pointer so we can modify it on the way down
-        std::string jsonPointerPathBoard = jsonPointerPath;
-        size_t exposesIndex = -1;
-        for (auto& item : *exposes)
+    if (job.nextReplaced < job.replacedRecords.size())
+    {
+        const ReplacedRecord& replaced =
+            job.replacedRecords[job.nextReplaced++];
+        auto findRecord = systemConfiguration.find(replaced.newName);
+        if (findRecord == systemConfiguration.end())
         {
-            exposesIndex++;
-            jsonPointerPath = jsonPointerPathBoard;
-            jsonPointerPath += std::to_string(exposesIndex);
-
-            auto findName = item.find("Name");
-            if (findName == item.end())
-            {
-                std::cerr << "cannot find name in field " << item << "\n";
-                continue;
-            }
-            auto findStatus = item.find("Status");
-            // if status is not found it is assumed to be status = 'okay'
-            if (findStatus != item.end())
-            {
-                if (*findStatus == "disabled")
-                {
-                    continue;
-                }
-            }
-            auto findType = item.find("Type");
-            std::string itemType;
-            if (findType != item.end())
-            {
-                itemType = findType->get<std::string>();
-                std::regex_replace(itemType.begin(), itemType.begin(),
-                                   itemType.end(), illegalDbusPathRegex, "_");
-            }
-            else
-            {
-                itemType = "unknown";
-            }
-            std::string itemName = findName->get<std::string>();
-            std::regex_replace(itemName.begin(), itemName.begin(),
-                               itemName.end(), illegalDbusMemberRegex, "_");
-            std::string ifacePath = boardPath;
-            ifacePath += "/";
-            ifacePath += itemName;
-
-            std::shared_ptr<sdbusplus::asio::dbus_interface> itemIface =
-                createInterface(objServer, ifacePath,
-                                "xyz.openbmc_project.Configuration." + itemType,
-                                boardNameOrig);
-
-            if (itemType == "BMC")
-            {
-                std::shared_ptr<sdbusplus::asio::dbus_interface> bmcIface =
-                    createInterface(objServer, ifacePath,
-                                    "xyz.openbmc_project.Inventory.Item.Bmc",
-                                    boardNameOrig);
-                populateInterfaceFromJson(systemConfiguration, jsonPointerPath,
-                                          bmcIface, item, objServer,
-                                          getPermission(itemType));
-            }
-            else if (itemType == "System")
-            {
-                std::shared_ptr<sdbusplus::asio::dbus_interface> systemIface =
-                    createInterface(objServer, ifacePath,
-                                    "xyz.openbmc_project.Inventory.Item.System",
-                                    boardNameOrig);
-                populateInterfaceFromJson(systemConfiguration, jsonPointerPath,
-                                          systemIface, item, objServer,
-                                          getPermission(itemType));
-            }
+            return true;
+        }
+        BoardLayout oldBoard = layoutBoard(replaced.oldName,
+                                           replaced.oldRecord);
+        BoardLayout board = layoutBoard(replaced.newName, *findRecord);
+        if (reconcileBoard(systemConfiguration, objServer, oldBoard, board))
+        {
+            job.newBoards.emplace(board.path, board.name);
+        }
 
-            populateInterfaceFromJson(systemConfiguration, jsonPointerPath,
-                                      itemIface, item, objServer,
-                                      getPermission(itemType));
+        // only boards whose ports changed end up with different associations
+        topology.remove(oldBoard.name);
+        for (const nlohmann::json* item : board.topologyItems)
+        {
+            topology.addBoard(board.path, board.type, board.name, *item);
+        }
+        return true;
+    }
+    return false;
+}
 
-            for (const auto& [name, config] : item.items())
-            {
-                jsonPointerPath = jsonPointerPathBoard;
-                jsonPointerPath.append(std::to_string(exposesIndex))
-                    .append("/")
-                    .append(name);
-                if (config.type() == nlohmann::json::value_t::object)
-                {
-                    std::string ifaceName =
-                        "xyz.openbmc_project.Configuration.";
-                    ifaceName.append(itemType).append(".").append(name);
+// Sets the Associations of the topology interface at path, creating the
+// interface if it isn't published or removing it if there are none.
+static void
+    updateTopologyInterface(sdbusplus::asio::object_server& objServer,
+                            const std::string& path,
+                            const std::vector<Association>& associations)
+{
+    std::shared_ptr<sdbusplus::asio::dbus_interface> iface;
+    auto findIface = topologyInterfaces.find(path);
+    if (findIface != topologyInterfaces.end())
+    {
+        iface = inventory.get(findIface->second);
+    }
+    if (iface && !associations.empty())
+    {
+        iface->set_property("Associations", associations);
+        return;
+    }
+    if (iface)
+    {
+        objServer.remove_interface(iface);
+    }
+    if (findIface != topologyInterfaces.end())
+    {
+        topologyInterfaces.erase(findIface);
+    }
 
-                    std::shared_ptr<sdbusplus::asio::dbus_interface>
-                        objectIface = createInterface(objServer, ifacePath,
-                                                      ifaceName, boardNameOrig);
+    const std::string* boardName = topology.getBoardName(path);
+    if (associations.empty() || boardName == nullptr)
+    {
+        return;
+    }
+    iface = objServer.add_interface(path, association::interface);
+    topologyInterfaces.emplace(path, inventory.add(*boardName, iface));
+    iface->register_property("Associations", associations);
+    tryIfaceInitialize(iface);
+}
 
-                    populateInterfaceFromJson(
-                        systemConfiguration, jsonPointerPath, objectIface,
-                        config, objServer, getPermission(name));
-                }
-                else if (config.type() == nlohmann::json::value_t::array)
-                {
-                    size_t index = 0;
-                    if (config.empty())
-                    {
-                        continue;
-                    }
-                    bool isLegal = true;
-                    auto type = config[0].type();
-                    if (type != nlohmann::json::value_t::object)
-                    {
-                        continue;
-                    }
+// Publishes the topology associations that changed with the job's boards.
+// Boards whose associations were republished lost their topology interface
+// with them, so theirs are published again even if unchanged.
+static void publishTopology(sdbusplus::asio::object_server& objServer,
+                            PublishJob& job)
+{
+    std::unordered_map<std::string, std::vector<Association>> changes =
+        topology.takeChanges();
+    for (const auto& [path, _] : job.newBoards)
+    {
+        const std::vector<Association>* associations =
+            topology.getAssociations(path);
+        if (associations != nullptr && !changes.contains(path))
+        {
+            changes.emplace(path, *associations);
+        }
+    }
 
-                    // verify legal json
-                    for (const auto& arrayItem : config)
-                    {
-                        if (arrayItem.type() != type)
-                        {
-                            isLegal = false;
-                            break;
-                        }
-                    }
-                    if (!isLegal)
-                    {
-                        std::cerr << "dbus format error" << config << "\n";
-                        break;
-                    }
+    for (const auto& [path, associations] : changes)
+    {
+        updateTopologyInterface(objServer, path, associations);
+    }
+}
 
-                    for (auto& arrayItem : config)
-                    {
-                        std::string ifaceName =
-                            "xyz.openbmc_project.Configuration.";
-                        ifaceName.append(itemType).append(".").append(name);
-                        ifaceName.append(std::to_string(index));
-
-                        std::shared_ptr<sdbusplus::asio::dbus_interface>
-                            objectIface = createInterface(
-                                objServer, ifacePath, ifaceName, boardNameOrig);
-
-                        populateInterfaceFromJson(
-                            systemConfiguration,
-                            jsonPointerPath + "/" + std::to_string(index),
-                            objectIface, arrayItem, objServer,
-                            getPermission(name));
-                        index++;
-                    }
-                }
-            }
+// Runs the job at the front of the queue for up to publishSliceBudget, then
+// yields the io loop to other work until the next slice.  At least one
+// record is published per slice.
+static void runPublishSlice(nlohmann::json& systemConfiguration,
+                            sdbusplus::asio::object_server& objServer)
+{
+    std::shared_ptr<PublishJob> job = publishQueue.front();
+    auto start = std::chrono::steady_clock::now();
+    if (!job->started)
+    {
+        startPublishJob(systemConfiguration, *job);
+    }
 
-            topology.addBoard(boardPath, boardType, boardNameOrig, item);
+    size_t records = 0;
+    bool more = publishNextRecord(systemConfiguration, objServer, *job);
+    while (more)
+    {
+        records++;
+        if (std::chrono::steady_clock::now() - start >= publishSliceBudget)
+        {
+            break;
         }
-
-        newBoards.emplace(boardPath, boardNameOrig);
+        more = publishNextRecord(systemConfiguration, objServer, *job);
+    }
+    if (!more)
+    {
+        publishTopology(objServer, *job);
     }
+    scanStatistics.recordPublishSlice(std::chrono::steady_clock::now() - start,
+                                      records);
 
-    for (const auto& [assocPath, assocPropValue] :
-         topology.getAssocs(newBoards))
+    if (!more)
     {
-        auto findBoard = newBoards.find(assocPath);
-        if (findBoard == newBoards.end())
+        publishQueue.pop_front();
+        if (job->done)
         {
-            continue;
+            job->done();
         }
+        if (publishQueue.empty())
+        {
+            return;
+        }
+    }
+    boost::asio::post(io, [&systemConfiguration, &objServer]() {
+        runPublishSlice(systemConfiguration, objServer);
+    });
+}
 
-        auto ifacePtr = createInterface(
-            objServer, assocPath, "xyz.openbmc_project.Association.Definitions",
-            findBoard->second);
-
-        ifacePtr->register_property("Associations", assocPropValue);
-        tryIfaceInitialize(ifacePtr);
+// Queues new records to be published, and replaced records to be reconciled,
+// on the io loop.  Batches are published one after the other, calling done
+// once each is complete.
+void postToDbus(nlohmann::json newConfiguration,
+                std::vector<ReplacedRecord> replacedRecords,
+                nlohmann::json& systemConfiguration,
+                sdbusplus::asio::object_server& objServer,
+                std::function<void()> done)
+{
+    auto job = std::make_shared<PublishJob>();
+    job->newConfiguration = std::move(newConfiguration);
+    job->replacedRecords = std::move(replacedRecords);
+    job->done = std::move(done);
+    publishQueue.push_back(std::move(job));
+    if (publishQueue.size() == 1)
+    {
+        boost::asio::post(io, [&systemConfiguration, &objServer]() {
+            runPublishSlice(systemConfiguration, objServer);
+        });
     }
 }
 
@@ -1306,12 +1907,6 @@ void startRemovedTimer(boost::asio::steady_timer& timer,
     });
 }
 
-static std::vector<std::weak_ptr<sdbusplus::asio::dbus_interface>>&
-    getDeviceInterfaces(const nlohmann::json& device)
-{
-    return inventory[device["Name"].get<std::string>()];
-}
-
 static void pruneConfiguration(nlohmann::json& systemConfiguration,
                                sdbusplus::asio::object_server& objServer,
                                bool powerOff, const std::string& name,
@@ -1323,20 +1918,20 @@ static void pruneConfiguration(nlohmann::json& systemConfiguration,
         return;
     }
 
-    auto& ifaces = getDeviceInterfaces(device);
-    for (auto& iface : ifaces)
-    {
-        auto sharedPtr = iface.lock();
-        if (!!sharedPtr)
-        {
-            objServer.remove_interface(sharedPtr);
-        }
-    }
-
-    ifaces.clear();
+    inventory.removeBoard(inventory.intern(device["Name"].get<std::string>()),
+                          [&objServer](const auto& iface) {
+        objServer.remove_interface(iface);
+    });
     systemConfiguration.erase(name);
+    exposeIndex.removeRecord(name);
+    recordBindings.remove(name);
     topology.remove(device["Name"].get<std::string>());
-    logDeviceRemoved(device);
+    // a provisional record was only ever seen by the last run, its removal is
+    // logged against lastJson like that of any record the scan didn't find
+    if (!provisionalRecords.contains(name))
+    {
+        logDeviceRemoved(device);
+    }
 }
 
 static void deriveNewConfiguration(const nlohmann::json& oldConfiguration,
@@ -1356,8 +1951,101 @@ static void deriveNewConfiguration(const nlohmann::json& oldConfiguration,
     }
 }
 
+// Finds the records that can be published by reconciling them with what is
+// already on D-Bus: records that changed in place, and new records replacing
+// a missing one of the same device name, such as when a FRU is rewritten.
+// Replaced records are taken out of missingConfigurations, newConfiguration
+// and systemConfiguration.
+static std::vector<ReplacedRecord> findReplacedRecords(
+    const nlohmann::json& oldConfiguration, nlohmann::json& systemConfiguration,
+    nlohmann::json& missingConfigurations, nlohmann::json& newConfiguration,
+    bool powerOff)
+{
+    std::vector<ReplacedRecord> replacedRecords;
+    for (const auto& [name, record] : oldConfiguration.items())
+    {
+        auto findRecord = systemConfiguration.find(name);
+        if (findRecord != systemConfiguration.end() && *findRecord != record &&
+            !missingConfigurations.contains(name))
+        {
+            replacedRecords.push_back({name, record, name});
+        }
+    }
+
+    for (auto missing = missingConfigurations.begin();
+         missing != missingConfigurations.end();)
+    {
+        auto findName = missing->find("Name");
+        if ((powerOff && deviceRequiresPowerOn(*missing)) ||
+            findName == missing->end())
+        {
+            missing++;
+            continue;
+        }
+        auto findNew = std::find_if(
+            newConfiguration.begin(), newConfiguration.end(),
+            [&findName](const nlohmann::json& record) {
+            auto recordName = record.find("Name");
+            return recordName != record.end() && *recordName == *findName;
+        });
+        if (findNew == newConfiguration.end())
+        {
+            missing++;
+            continue;
+        }
+
+        // the published properties read the new record from here on
+        recordBindings.rename(missing.key(), findNew.key());
+        replacedRecords.push_back(
+            {missing.key(), std::move(*missing), findNew.key()});
+        systemConfiguration.erase(missing.key());
+        exposeIndex.removeRecord(missing.key());
+        newConfiguration.erase(findNew);
+        missing = missingConfigurations.erase(missing);
+    }
+    return replacedRecords;
+}
+
+// Takes the provisional records the scan has accounted for out of
+// provisionalRecords, and returns those it found.  Records that are still
+// missing, such as those that need power on, stay provisional.
+static nlohmann::json confirmProvisionalRecords(
+    const nlohmann::json& systemConfiguration,
+    const nlohmann::json& missingConfigurations,
+    const std::vector<ReplacedRecord>& replacedRecords)
+{
+    nlohmann::json confirmed = nlohmann::json::object();
+    for (const ReplacedRecord& replaced : replacedRecords)
+    {
+        auto findRecord = systemConfiguration.find(replaced.newName);
+        if (provisionalRecords.erase(replaced.oldName) != 0 &&
+            findRecord != systemConfiguration.end())
+        {
+            confirmed[replaced.newName] = *findRecord;
+        }
+    }
+    for (auto it = provisionalRecords.begin(); it != provisionalRecords.end();)
+    {
+        auto findRecord = systemConfiguration.find(*it);
+        if (findRecord == systemConfiguration.end())
+        {
+            // pruned
+            it = provisionalRecords.erase(it);
+            continue;
+        }
+        if (missingConfigurations.contains(*it))
+        {
+            it++;
+            continue;
+        }
+        confirmed[*it] = *findRecord;
+        it = provisionalRecords.erase(it);
+    }
+    return confirmed;
+}
+
 static void publishNewConfiguration(
-    const size_t& instance, const size_t count,
+    const size_t& instance, const size_t count, const bool complete,
     boost::asio::steady_timer& timer, nlohmann::json& systemConfiguration,
     // Gerrit discussion:
     // https://gerrit.openbmc-project.xyz/c/openbmc/entity-manager/+/52316/6
@@ -1366,22 +2054,31 @@ static void publishNewConfiguration(
     // https://discord.com/channels/775381525260664832/867820390406422538/958048437729910854
     //
     // NOLINTNEXTLINE(performance-unnecessary-value-param)
-    const nlohmann::json newConfiguration,
+    nlohmann::json newConfiguration,
+    std::vector<ReplacedRecord> replacedRecords,
     sdbusplus::asio::object_server& objServer)
 {
     loadOverlays(newConfiguration);
-
-    boost::asio::post(io, [systemConfiguration]() {
-        if (!writeJsonFiles(systemConfiguration))
+    for (const ReplacedRecord& replaced : replacedRecords)
+    {
+        auto findRecord = systemConfiguration.find(replaced.newName);
+        if (findRecord != systemConfiguration.end() &&
+            findRecord->value("Exposes", nlohmann::json()) !=
+                replaced.oldRecord.value("Exposes", nlohmann::json()))
         {
-            std::cerr << "Error writing json files\n";
+            loadOverlays(nlohmann::json{{replaced.newName, *findRecord}});
         }
-    });
+    }
+
+    writeJsonFiles(systemConfiguration);
 
-    boost::asio::post(io, [&instance, count, &timer, newConfiguration,
-                           &systemConfiguration, &objServer]() {
-        postToDbus(newConfiguration, systemConfiguration, objServer);
-        if (count == instance)
+    postToDbus(std::move(newConfiguration), std::move(replacedRecords),
+               systemConfiguration, objServer,
+               [&instance, count, complete, &timer, &systemConfiguration]() {
+        // records that need power on stay provisional until a scan with
+        // power on accounts for them
+        entityIface->set_property("Provisional", !provisionalRecords.empty());
+        if (count == instance && complete)
         {
             startRemovedTimer(timer, systemConfiguration);
         }
@@ -1434,22 +2131,41 @@ void propertiesChangedCallback(nlohmann::json& systemConfiguration,
         }
 
         auto perfScan = std::make_shared<PerformScan>(
-            systemConfiguration, *missingConfigurations, configurations,
-            objServer,
+            systemConfiguration, *missingConfigurations,
+            std::move(configurations), objServer,
             [&systemConfiguration, &objServer, count, oldConfiguration,
-             missingConfigurations]() {
-            // this is something that since ac has been applied to the bmc
-            // we saw, and we no longer see it
+             missingConfigurations](bool complete) {
+            nlohmann::json newConfiguration = systemConfiguration;
+
+            deriveNewConfiguration(oldConfiguration, newConfiguration);
+
             bool powerOff = !isPowerOn();
-            for (const auto& [name, device] : missingConfigurations->items())
+            std::vector<ReplacedRecord> replacedRecords = findReplacedRecords(
+                oldConfiguration, systemConfiguration, *missingConfigurations,
+                newConfiguration, powerOff);
+
+            // this is something that since ac has been applied to the bmc
+            // we saw, and we no longer see it.  A scan cut short by its
+            // deadline may just not have probed it again, so it is kept until
+            // a scan completes.
+            if (complete)
             {
-                pruneConfiguration(systemConfiguration, objServer, powerOff,
-                                   name, device);
+                for (const auto& [name, device] :
+                     missingConfigurations->items())
+                {
+                    pruneConfiguration(systemConfiguration, objServer,
+                                       powerOff, name, device);
+                }
             }
 
-            nlohmann::json newConfiguration = systemConfiguration;
-
-            deriveNewConfiguration(oldConfiguration, newConfiguration);
+            // found again, so published as they would have been from cold
+            nlohmann::json confirmed = confirmProvisionalRecords(
+                systemConfiguration, *missingConfigurations, replacedRecords);
+            for (const auto& [_, device] : confirmed.items())
+            {
+                logDeviceAdded(device);
+            }
+            loadOverlays(confirmed);
 
             for (const auto& [_, device] : newConfiguration.items())
             {
@@ -1460,14 +2176,199 @@ void propertiesChangedCallback(nlohmann::json& systemConfiguration,
 
             boost::asio::post(
                 io, std::bind_front(publishNewConfiguration, std::ref(instance),
-                                    count, std::ref(timer),
+                                    count, complete, std::ref(timer),
                                     std::ref(systemConfiguration),
-                                    newConfiguration, std::ref(objServer)));
+                                    newConfiguration,
+                                    std::move(replacedRecords),
+                                    std::ref(objServer)));
         });
         perfScan->run();
     });
 }
 
+// Returns the name referenced by a FOUND('name') probe statement.
+static std::optional<std::string> getFoundProbeTarget(const std::string& probe)
+{
+    auto findStart = probe.find('(');
+    auto findEnd = probe.rfind(')');
+    if (findStart == std::string::npos || findEnd == std::string::npos ||
+        findEnd < findStart)
+    {
+        return std::nullopt;
+    }
+    std::string target = probe.substr(findStart + 1, findEnd - findStart - 1);
+    boost::replace_all(target, "'", "");
+    return target;
+}
+
+// Static configurations are those whose probes don't need anything from D-Bus:
+// they only use TRUE, FALSE and the logic operators, or FOUND on other static
+// configurations.  Their outcome is known as soon as they are loaded.
+static std::set<const nlohmann::json*>
+    getStaticConfigurations(const std::list<nlohmann::json>& configurations)
+{
+    // configuration -> the names its FOUND probes refer to
+    std::map<const nlohmann::json*, std::vector<std::string>> candidates;
+    for (const nlohmann::json& configuration : configurations)
+    {
+        auto findProbe = configuration.find("Probe");
+        auto findName = configuration.find("Name");
+        if (findProbe == configuration.end() ||
+            findName == configuration.end() || !findName->is_string())
+        {
+            continue;
+        }
+
+        nlohmann::json probeCommand = *findProbe;
+        if (!probeCommand.is_array())
+        {
+            probeCommand = nlohmann::json::array({probeCommand});
+        }
+
+        bool isStatic = true;
+        std::vector<std::string> targets;
+        for (const nlohmann::json& probeJson : probeCommand)
+        {
+            const std::string* probe = probeJson.get_ptr<const std::string*>();
+            if (probe == nullptr)
+            {
+                isStatic = false;
+                break;
+            }
+            FoundProbeTypeT probeType = findProbeType(*probe);
+            if (!probeType)
+            {
+                isStatic = false;
+                break;
+            }
+            if ((*probeType)->second != probe_type_codes::FOUND)
+            {
+                continue;
+            }
+            std::optional<std::string> target = getFoundProbeTarget(*probe);
+            if (!target)
+            {
+                isStatic = false;
+                break;
+            }
+            targets.emplace_back(std::move(*target));
+        }
+        if (isStatic)
+        {
+            candidates.emplace(&configuration, std::move(targets));
+        }
+    }
+
+    std::set<const nlohmann::json*> staticConfigurations;
+    std::set<std::string> staticNames;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto it = candidates.begin(); it != candidates.end();)
+        {
+            const std::vector<std::string>& targets = it->second;
+            if (!std::all_of(targets.begin(), targets.end(),
+                             [&staticNames](const std::string& target) {
+                return staticNames.contains(target);
+            }))
+            {
+                it++;
+                continue;
+            }
+            staticConfigurations.emplace(it->first);
+            staticNames.emplace((*it->first)["Name"].get<std::string>());
+            it = candidates.erase(it);
+            changed = true;
+        }
+    }
+    return staticConfigurations;
+}
+
+// Finds and publishes the static configurations at startup, ahead of the
+// first full scan, so that they don't have to wait on the debounce timer or on
+// any mapper and GetAll traffic.  The full scan finds the same records again
+// and leaves them alone.
+static void publishStaticConfigurations(
+    nlohmann::json& systemConfiguration,
+    sdbusplus::asio::object_server& objServer)
+{
+    std::list<nlohmann::json> configurations;
+    if (!loadConfigurations(configurations))
+    {
+        return;
+    }
+
+    std::set<const nlohmann::json*> staticConfigurations =
+        getStaticConfigurations(configurations);
+    configurations.remove_if(
+        [&staticConfigurations](const nlohmann::json& configuration) {
+        return !staticConfigurations.contains(&configuration);
+    });
+    if (configurations.empty())
+    {
+        return;
+    }
+
+    nlohmann::json oldConfiguration = systemConfiguration;
+    auto missingConfigurations = std::make_shared<nlohmann::json>(
+        nlohmann::json::object());
+
+    auto perfScan = std::make_shared<PerformScan>(
+        systemConfiguration, *missingConfigurations, std::move(configurations),
+        objServer,
+        [&systemConfiguration, &objServer, oldConfiguration,
+         missingConfigurations](bool) {
+        nlohmann::json newConfiguration = systemConfiguration;
+
+        deriveNewConfiguration(oldConfiguration, newConfiguration);
+
+        for (const auto& [_, device] : newConfiguration.items())
+        {
+            logDeviceAdded(device);
+        }
+
+        loadOverlays(newConfiguration);
+        postToDbus(std::move(newConfiguration), {}, systemConfiguration,
+                   objServer, nullptr);
+        writeJsonFiles(systemConfiguration);
+    });
+    perfScan->run();
+}
+
+// Publishes the configuration persisted by the last run ahead of the first
+// full scan, so that inventory is on D-Bus within moments of startup rather
+// than after the debounce and a scan.  The records are provisional until a
+// scan accounts for them: those it finds are kept as they are, and those it
+// doesn't are pruned like any other missing record.
+static void
+    publishPersistedConfiguration(nlohmann::json& systemConfiguration,
+                                  sdbusplus::asio::object_server& objServer)
+{
+    nlohmann::json newConfiguration = nlohmann::json::object();
+    for (const auto& [name, record] : lastJson.items())
+    {
+        if (!record.is_object() || !record.contains("Name"))
+        {
+            continue;
+        }
+        nlohmann::json& published = systemConfiguration[name];
+        published = record;
+        pruneRecordExposes(published);
+        exposeIndex.addRecord(name, published);
+        newConfiguration[name] = published;
+        provisionalRecords.emplace(name);
+    }
+    if (newConfiguration.empty())
+    {
+        return;
+    }
+
+    entityIface->set_property("Provisional", true);
+    postToDbus(std::move(newConfiguration), {}, systemConfiguration, objServer,
+               nullptr);
+}
+
 // Extract the D-Bus interfaces to probe from the JSON config files.
 static std::set<std::string> getProbeInterfaces()
 {
@@ -1573,7 +2474,7 @@ int main()
     systemBus = std::make_shared<sdbusplus::asio::connection>(io);
     systemBus->request_name("xyz.openbmc_project.EntityManager");
 
-    // The EntityManager object itself doesn't expose any properties.
+    // The EntityManager object itself doesn't expose any inventory.
     // No need to set up ObjectManager for the |EntityManager| object.
     sdbusplus::asio::object_server objServer(systemBus, /*skipManager=*/true);
 
@@ -1583,9 +2484,8 @@ int main()
     // https://discord.com/channels/775381525260664832/1018929092009144380
     objServer.add_manager("/xyz/openbmc_project/inventory");
 
-    std::shared_ptr<sdbusplus::asio::dbus_interface> entityIface =
-        objServer.add_interface("/xyz/openbmc_project/EntityManager",
-                                "xyz.openbmc_project.EntityManager");
+    entityIface = objServer.add_interface("/xyz/openbmc_project/EntityManager",
+                                          "xyz.openbmc_project.EntityManager");
 
     // to keep reference to the match / filter objects so they don't get
     // destroyed
@@ -1635,15 +2535,59 @@ int main()
         }
     });
 
+    // The fruDevice endpoints cached for persistProperty are stale once the
+    // mapper changes or removes the association.
+    sdbusplus::bus::match_t endpointsChangedMatch(
+        static_cast<sdbusplus::bus_t&>(*systemBus),
+        sdbusplus::bus::match::rules::propertiesChangedNamespace(
+            "/xyz/openbmc_project/inventory", endpointsIface),
+        [](sdbusplus::message_t& msg) {
+        invalidateFruEndpoints(msg.get_path());
+    });
+    sdbusplus::bus::match_t endpointsRemovedMatch(
+        static_cast<sdbusplus::bus_t&>(*systemBus),
+        sdbusplus::bus::match::rules::interfacesRemoved() +
+            sdbusplus::bus::match::rules::sender(mapperService),
+        [](sdbusplus::message_t& msg) {
+        sdbusplus::message::object_path path;
+        std::vector<std::string> interfaces;
+        msg.read(path, interfaces);
+        if (std::find(interfaces.begin(), interfaces.end(), endpointsIface) !=
+            interfaces.end())
+        {
+            invalidateFruEndpoints(path.str);
+        }
+    });
+
     boost::asio::post(io, [&]() {
+        publishStaticConfigurations(systemConfiguration, objServer);
         propertiesChangedCallback(systemConfiguration, objServer);
     });
 
     entityIface->register_method("ReScan", [&]() {
         propertiesChangedCallback(systemConfiguration, objServer);
     });
+    // True while any inventory published from the persisted configuration
+    // hasn't been reconciled by a scan yet.
+    entityIface->register_property("Provisional", false);
     tryIfaceInitialize(entityIface);
 
+    std::shared_ptr<sdbusplus::asio::dbus_interface> statisticsIface =
+        objServer.add_interface("/xyz/openbmc_project/EntityManager",
+                                "xyz.openbmc_project.EntityManager.Statistics");
+    // One row per (service, interface, method) called while scanning, see
+    // ScanStatistics for the histogram layout.
+    statisticsIface->register_method("GetScanStatistics",
+                                     []() { return scanStatistics.rows(); });
+    // How long publishing held the io loop, one histogram entry per slice.
+    statisticsIface->register_method(
+        "GetPublishStatistics", []() { return scanStatistics.publishRow(); });
+    // Bytes of system configuration written to flash since startup.
+    statisticsIface->register_property_r<uint64_t>(
+        "BytesPersisted", 0, sdbusplus::vtable::property_::none,
+        [](const uint64_t&) { return persister.bytesWritten(); });
+    tryIfaceInitialize(statisticsIface);
+
     if (fwVersionIsSame())
     {
         if (std::filesystem::is_regular_file(currentConfiguration))
@@ -1654,10 +2598,12 @@ int main()
             std::filesystem::copy(currentConfiguration, lastConfiguration);
             std::filesystem::remove(currentConfiguration);
 
-            std::ifstream jsonStream(lastConfiguration);
+            // either format is read back, so changing it keeps the
+            // configuration
+            std::ifstream jsonStream(lastConfiguration, std::ios::binary);
             if (jsonStream.good())
             {
-                auto data = nlohmann::json::parse(jsonStream, nullptr, false);
+                auto data = readConfiguration(jsonStream);
                 if (data.is_discarded())
                 {
                     std::cerr << "syntax error in " << lastConfiguration
@@ -1666,6 +2612,12 @@ int main()
                 else
                 {
                     lastJson = std::move(data);
+                    persister.replay(lastJson);
+                    if (warmStart)
+                    {
+                        publishPersistedConfiguration(systemConfiguration,
+                                                      objServer);
+                    }
                 }
             }
             else
@@ -1680,6 +2632,8 @@ int main()
         std::cerr << "Clearing previous configuration\n";
         std::filesystem::remove(currentConfiguration);
     }
+    // the replayed changes are written out with the first scan
+    persister.discardJournal();
 
     // some boards only show up after power is on, we want to not say they are
     // removed until the same state happens
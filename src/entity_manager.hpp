@@ -17,11 +17,15 @@
 
 #pragma once
 
+#include "expose_index.hpp"
 #include "utils.hpp"
 
 #include <systemd/sd-journal.h>
 
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
 #include <nlohmann/json.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 
@@ -67,41 +71,50 @@ using FoundProbeTypeT =
                                              CmpStr>::const_iterator>;
 FoundProbeTypeT findProbeType(const std::string& probe);
 
+struct ScanFetch;
+
+// Runs one scan as a coroutine pipeline on io:
+//   fetch   - query the mapper and GetAll every interface the probes need
+//   probe   - evaluate the probe statements against what was fetched
+//   expand  - instantiate the records of the configurations that matched
+// Those stages repeat for as long as a pass finds something new, as FOUND
+// probes may depend on records found in the previous pass, and then
+//   publish - hand over to the callback
 struct PerformScan : std::enable_shared_from_this<PerformScan>
 {
     PerformScan(nlohmann::json& systemConfiguration,
                 nlohmann::json& missingConfigurations,
-                std::list<nlohmann::json>& configurations,
+                std::list<nlohmann::json>&& configurations,
                 sdbusplus::asio::object_server& objServer,
-                std::function<void()>&& callback);
-    void updateSystemConfiguration(const nlohmann::json& recordRef,
-                                   const std::string& probeName,
-                                   FoundDevices& foundDevices);
+                std::function<void(bool complete)>&& callback);
+    boost::asio::awaitable<void>
+        updateSystemConfiguration(const nlohmann::json& recordRef,
+                                  const std::string& probeName,
+                                  FoundDevices& foundDevices);
     void run();
-    virtual ~PerformScan();
+    // Stop waiting on D-Bus; the scan completes with what it has found.
+    void cancel();
+    boost::asio::awaitable<void>
+        fetch(boost::container::flat_set<std::string> interfaces);
     nlohmann::json& _systemConfiguration;
     nlohmann::json& _missingConfigurations;
     std::list<nlohmann::json> _configurations;
     sdbusplus::asio::object_server& objServer;
-    std::function<void()> _callback;
-    bool _passed = false;
+    // called with false if the deadline cut the scan short
+    std::function<void(bool complete)> _callback;
     MapperGetSubTreeResponse dbusProbeObjects;
     std::vector<std::string> passedProbes;
+    PropertyProjection projection;
+    boost::asio::steady_timer deadlineTimer;
+    std::weak_ptr<ScanFetch> currentFetch;
+    bool _cancelled = false;
 };
 
-// this class finds the needed dbus fields and on destruction runs the probe
-struct PerformProbe : std::enable_shared_from_this<PerformProbe>
-{
-    PerformProbe(nlohmann::json& recordRef,
-                 const std::vector<std::string>& probeCommand,
-                 std::string probeName, std::shared_ptr<PerformScan>& scanPtr);
-    virtual ~PerformProbe();
-
-    nlohmann::json& recordRef;
-    std::vector<std::string> _probeCommand;
-    std::string probeName;
-    std::shared_ptr<PerformScan> scan;
-};
+bool probe(const std::vector<std::string>& probeCommand,
+           const PerformScan& scan, FoundDevices& foundDevs);
+
+// Drops the exposes deleted from a persisted record, before it is reused.
+void pruneRecordExposes(nlohmann::json& record);
 
 inline void logDeviceAdded(const nlohmann::json& record)
 {
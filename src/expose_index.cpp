@@ -0,0 +1,78 @@
+#include "expose_index.hpp"
+
+void ExposeNameIndex::addRecords(const nlohmann::json& systemConfiguration)
+{
+    for (const auto& [recordName, record] : systemConfiguration.items())
+    {
+        addRecord(recordName, record);
+    }
+}
+
+void ExposeNameIndex::addRecord(const std::string& recordName,
+                                const nlohmann::json& record)
+{
+    removeRecord(recordName);
+
+    auto findExposes = record.find("Exposes");
+    if (findExposes == record.end() || !findExposes->is_array())
+    {
+        return;
+    }
+
+    std::vector<std::string>& names = namesByRecord[recordName];
+    for (size_t index = 0; index < findExposes->size(); index++)
+    {
+        const nlohmann::json& expose = (*findExposes)[index];
+        if (!expose.is_object())
+        {
+            continue;
+        }
+        auto findName = expose.find("Name");
+        if (findName == expose.end() || !findName->is_string())
+        {
+            continue;
+        }
+        const std::string& name = findName->get_ref<const std::string&>();
+        byName[name].emplace(recordName, index);
+        names.push_back(name);
+    }
+}
+
+void ExposeNameIndex::removeRecord(const std::string& recordName)
+{
+    auto findRecord = namesByRecord.find(recordName);
+    if (findRecord == namesByRecord.end())
+    {
+        return;
+    }
+
+    for (const std::string& name : findRecord->second)
+    {
+        auto findName = byName.find(name);
+        if (findName == byName.end())
+        {
+            continue;
+        }
+        std::erase_if(findName->second, [&recordName](const Location& loc) {
+            return loc.first == recordName;
+        });
+        if (findName->second.empty())
+        {
+            byName.erase(findName);
+        }
+    }
+    namesByRecord.erase(findRecord);
+}
+
+const std::set<ExposeNameIndex::Location>&
+    ExposeNameIndex::find(const std::string& name) const
+{
+    static const std::set<Location> none;
+
+    auto findName = byName.find(name);
+    if (findName == byName.end())
+    {
+        return none;
+    }
+    return findName->second;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// \brief Finds the Exposes entries of a system configuration by their Name.
+///
+/// Used to resolve the Bind and DisableNode expose actions without walking
+/// every record.  The index only knows about the records added to it, so it
+/// has to be told whenever a record is replaced or removed.
+class ExposeNameIndex
+{
+  public:
+    /// (record name, index in the record's Exposes array)
+    using Location = std::pair<std::string, size_t>;
+
+    /// \brief Index every record of a system configuration.
+    void addRecords(const nlohmann::json& systemConfiguration);
+
+    /// \brief Index a record, replacing what was indexed for it before.
+    void addRecord(const std::string& recordName, const nlohmann::json& record);
+
+    void removeRecord(const std::string& recordName);
+
+    /// \param name the Name of the Exposes entries to find.
+    /// \return their locations, ordered as a walk of the system configuration
+    /// would visit them.
+    const std::set<Location>& find(const std::string& name) const;
+
+  private:
+    std::map<std::string, std::set<Location>> byName;
+    std::map<std::string, std::vector<std::string>> namesByRecord;
+};
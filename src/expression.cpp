@@ -17,12 +17,12 @@
 
 #include "expression.hpp"
 
-#include <iostream>
-#include <stdexcept>
+#include <array>
+#include <charconv>
 
 namespace expression
 {
-std::optional<Operation> parseOperation(std::string& op)
+std::optional<Operation> parseOperation(const std::string& op)
 {
     if (op == "+")
     {
@@ -48,80 +48,146 @@ std::optional<Operation> parseOperation(std::string& op)
     return std::nullopt;
 }
 
-int evaluate(int a, Operation op, int b)
+static bool bindsTighter(Operation op)
 {
-    switch (op)
+    return op == Operation::multiplication || op == Operation::division ||
+           op == Operation::modulo;
+}
+
+static std::optional<int64_t> parseConstant(std::string_view word)
+{
+    int base = 10;
+    if (word.starts_with("0x"))
     {
-        case Operation::addition:
-        {
-            return a + b;
-        }
-        case Operation::subtraction:
+        word.remove_prefix(2);
+        base = 16;
+    }
+    int64_t value = 0;
+    const char* wordEnd = word.data() + word.size();
+    std::from_chars_result res = std::from_chars(word.data(), wordEnd, value,
+                                                 base);
+    if (word.empty() || res.ec != std::errc{} || res.ptr != wordEnd)
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+std::optional<Program>
+    Program::compile(std::vector<std::string>::const_iterator curr,
+                     std::vector<std::string>::const_iterator& end,
+                     std::string_view variable)
+{
+    Program program;
+    // With two levels of precedence at most one operator of each is pending
+    std::vector<Operation> pending;
+
+    for (; curr != end; curr++)
+    {
+        std::optional<Operation> op = parseOperation(*curr);
+        if (!op)
         {
-            return a - b;
+            break;
         }
-        case Operation::multiplication:
+        if (++curr == end)
         {
-            return a * b;
+            return std::nullopt;
         }
-        case Operation::division:
+
+        Instruction operand{Code::pushVariable, 0, *op};
+        if (*curr != variable)
         {
-            if (b == 0)
+            std::optional<int64_t> constant = parseConstant(*curr);
+            if (!constant)
             {
-                throw std::runtime_error(
-                    "Math error: Attempted to divide by Zero\n");
+                return std::nullopt;
             }
-            return a / b;
+            operand.code = Code::pushConstant;
+            operand.constant = *constant;
         }
-        case Operation::modulo:
+
+        while (!pending.empty() &&
+               (bindsTighter(pending.back()) || !bindsTighter(*op)))
         {
-            if (b == 0)
-            {
-                throw std::runtime_error(
-                    "Math error: Attempted to divide by Zero\n");
-            }
-            return a % b;
+            program.instructions.push_back({Code::apply, 0, pending.back()});
+            pending.pop_back();
         }
-
-        default:
-            throw std::invalid_argument("Unrecognised operation");
+        program.instructions.push_back(operand);
+        pending.push_back(*op);
     }
+    while (!pending.empty())
+    {
+        program.instructions.push_back({Code::apply, 0, pending.back()});
+        pending.pop_back();
+    }
+
+    end = curr;
+    return program;
 }
 
-int evaluate(int substitute, std::vector<std::string>::iterator curr,
-             std::vector<std::string>::iterator& end)
+std::optional<int64_t> Program::run(int64_t substitute, int64_t variable) const
 {
-    bool isOperator = true;
-    std::optional<Operation> next = Operation::addition;
+    // the substitute plus one pending operand of each precedence
+    std::array<int64_t, 3> stack{};
+    size_t depth = 0;
+    stack[depth++] = substitute;
 
-    for (; curr != end; curr++)
+    for (const Instruction& instruction : instructions)
     {
-        if (isOperator)
+        switch (instruction.code)
         {
-            next = expression::parseOperation(*curr);
-            if (!next)
+            case Code::pushConstant:
             {
+                stack[depth++] = instruction.constant;
                 break;
             }
-        }
-        else
-        {
-            try
+            case Code::pushVariable:
             {
-                int constant = std::stoi(*curr);
-                substitute = evaluate(substitute, *next, constant);
+                stack[depth++] = variable;
+                break;
             }
-            catch (const std::invalid_argument&)
+            case Code::apply:
             {
-                std::cerr << "Parameter not supported for templates " << *curr
-                          << "\n";
-                continue;
+                int64_t b = stack[--depth];
+                int64_t& a = stack[depth - 1];
+                bool overflow = false;
+                switch (instruction.op)
+                {
+                    case Operation::addition:
+                    {
+                        overflow = __builtin_add_overflow(a, b, &a);
+                        break;
+                    }
+                    case Operation::subtraction:
+                    {
+                        overflow = __builtin_sub_overflow(a, b, &a);
+                        break;
+                    }
+                    case Operation::multiplication:
+                    {
+                        overflow = __builtin_mul_overflow(a, b, &a);
+                        break;
+                    }
+                    case Operation::division:
+                    case Operation::modulo:
+                    {
+                        if (b == 0 || (b == -1 && a == INT64_MIN))
+                        {
+                            return std::nullopt;
+                        }
+                        a = instruction.op == Operation::division ? a / b
+                                                                  : a % b;
+                        break;
+                    }
+                }
+                if (overflow)
+                {
+                    return std::nullopt;
+                }
+                break;
             }
         }
-        isOperator = !isOperator;
     }
-
-    end = curr;
-    return substitute;
+    return stack[0];
 }
 } // namespace expression
@@ -17,8 +17,10 @@
 
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace expression
@@ -33,7 +35,46 @@ enum class Operation
 };
 
 std::optional<Operation> parseOperation(const std::string& op);
-int evaluate(int a, Operation op, int b);
-int evaluate(int substitute, std::vector<std::string>::iterator curr,
-             std::vector<std::string>::iterator& end);
+
+/// \brief An arithmetic expression compiled to a postfix program.
+///
+/// Expressions are written as words following a substitute value, as in
+/// "+ 4 * 2".  Multiplication, division and modulo bind tighter than addition
+/// and subtraction, and evaluation is done in 64 bits.
+class Program
+{
+  public:
+    /// \brief Compile the expression at the start of a list of words.
+    /// \param curr the first word, an operator.
+    /// \param end the end of the words.  Set to the first word that isn't
+    /// part of the expression.
+    /// \param variable a word that stands for the variable passed to run.
+    /// \return the program, or nullopt if an operator lacks a valid operand.
+    static std::optional<Program>
+        compile(std::vector<std::string>::const_iterator curr,
+                std::vector<std::string>::const_iterator& end,
+                std::string_view variable);
+
+    /// \param substitute the value the expression is applied to.
+    /// \param variable the value of the variable word.
+    /// \return the result, or nullopt on division by zero or overflow.
+    std::optional<int64_t> run(int64_t substitute, int64_t variable) const;
+
+  private:
+    enum class Code
+    {
+        pushConstant,
+        pushVariable,
+        apply,
+    };
+
+    struct Instruction
+    {
+        Code code;
+        int64_t constant;
+        Operation op;
+    };
+
+    std::vector<Instruction> instructions;
+};
 } // namespace expression
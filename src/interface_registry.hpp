@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// \brief The interfaces published for each board, so they can be torn down
+/// with the board.
+///
+/// Interfaces are owned by the object server and only observed here.  Each
+/// one takes a slot, found from the board in O(1) and freed for reuse when the
+/// interface is released.  A slot's generation is bumped every time it is
+/// freed, so a handle to an interface that has since been released is
+/// recognised as stale rather than finding whatever reuses the slot.
+///
+/// Interfaces removed behind the registry's back, such as by their Delete
+/// method, leave an expired slot.  Those are swept when a board's slot count
+/// doubles, which keeps adding amortized O(1).
+template <typename Interface>
+class InterfaceRegistry
+{
+  public:
+    using BoardId = uint32_t;
+
+    struct Handle
+    {
+        uint32_t slot;
+        uint32_t generation;
+    };
+
+    /// \return the id of the board, which stays the same for the life of the
+    /// registry.
+    BoardId intern(const std::string& board)
+    {
+        auto [it, inserted] = boardIds.try_emplace(
+            board, static_cast<BoardId>(boards.size()));
+        if (inserted)
+        {
+            boards.emplace_back();
+        }
+        return it->second;
+    }
+
+    Handle add(BoardId board, const std::shared_ptr<Interface>& iface)
+    {
+        Board& entry = boards[board];
+        if (entry.slots.size() >= entry.sweepAt)
+        {
+            sweep(board);
+            entry.sweepAt = std::max(minSweep, entry.slots.size() * 2);
+        }
+
+        uint32_t index = 0;
+        if (freeSlots.empty())
+        {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        else
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        Slot& slot = slots[index];
+        slot.iface = iface;
+        slot.board = board;
+        slot.position = static_cast<uint32_t>(entry.slots.size());
+        entry.slots.push_back(index);
+        return {index, slot.generation};
+    }
+
+    Handle add(const std::string& board,
+               const std::shared_ptr<Interface>& iface)
+    {
+        return add(intern(board), iface);
+    }
+
+    /// \return the interface, or nullptr if the handle is stale or the
+    /// interface was removed.
+    std::shared_ptr<Interface> get(Handle handle) const
+    {
+        if (handle.slot >= slots.size() ||
+            slots[handle.slot].generation != handle.generation)
+        {
+            return nullptr;
+        }
+        return slots[handle.slot].iface.lock();
+    }
+
+    /// \brief Forget an interface without removing it.
+    /// \return false if the handle was stale.
+    bool release(Handle handle)
+    {
+        if (handle.slot >= slots.size() ||
+            slots[handle.slot].generation != handle.generation)
+        {
+            return false;
+        }
+        Slot& slot = slots[handle.slot];
+        Board& entry = boards[slot.board];
+        uint32_t moved = entry.slots.back();
+        entry.slots[slot.position] = moved;
+        slots[moved].position = slot.position;
+        entry.slots.pop_back();
+        free(handle.slot);
+        return true;
+    }
+
+    /// \brief Call callback(iface) with each live interface of a board.
+    /// callback mustn't add to or remove from the registry.
+    template <typename Callback>
+    void forEach(BoardId board, Callback&& callback) const
+    {
+        for (uint32_t index : boards[board].slots)
+        {
+            std::shared_ptr<Interface> iface = slots[index].iface.lock();
+            if (iface)
+            {
+                callback(iface);
+            }
+        }
+    }
+
+    /// \brief Call remove(iface) with each live interface of a board, and free
+    /// all of its slots.  remove mustn't add to or remove from the registry.
+    template <typename Callback>
+    void removeBoard(BoardId board, Callback&& remove)
+    {
+        Board& entry = boards[board];
+        for (uint32_t index : entry.slots)
+        {
+            std::shared_ptr<Interface> iface = slots[index].iface.lock();
+            if (iface)
+            {
+                remove(iface);
+            }
+            free(index);
+        }
+        entry.slots.clear();
+        entry.sweepAt = minSweep;
+    }
+
+    /// \brief Free the slots of a board whose interface is gone.
+    void sweep(BoardId board)
+    {
+        Board& entry = boards[board];
+        size_t kept = 0;
+        for (uint32_t index : entry.slots)
+        {
+            if (slots[index].iface.expired())
+            {
+                free(index);
+                continue;
+            }
+            slots[index].position = static_cast<uint32_t>(kept);
+            entry.slots[kept++] = index;
+        }
+        entry.slots.resize(kept);
+    }
+
+    /// \return the number of slots a board holds, including expired ones not
+    /// yet swept.
+    size_t size(BoardId board) const
+    {
+        return boards[board].slots.size();
+    }
+
+  private:
+    static constexpr size_t minSweep = 16;
+
+    struct Slot
+    {
+        std::weak_ptr<Interface> iface;
+        BoardId board = 0;
+        // index of the slot in its board's list
+        uint32_t position = 0;
+        uint32_t generation = 0;
+    };
+
+    struct Board
+    {
+        std::vector<uint32_t> slots;
+        size_t sweepAt = minSweep;
+    };
+
+    void free(uint32_t index)
+    {
+        slots[index].iface.reset();
+        slots[index].generation++;
+        freeSlots.push_back(index);
+    }
+
+    std::unordered_map<std::string, BoardId> boardIds;
+    std::vector<Board> boards;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+};
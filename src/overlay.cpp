@@ -31,7 +31,6 @@
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
-#include <regex>
 #include <string>
 
 constexpr const char* outputDir = "/tmp/overlays";
@@ -41,8 +40,6 @@ constexpr const char* muxSymlinkDir = "/dev/i2c-mux";
 
 constexpr const bool debug = false;
 
-const std::regex illegalNameRegex("[^A-Za-z0-9_]");
-
 // helper function to make json types into string
 std::string jsonToString(const nlohmann::json& in)
 {
@@ -240,8 +237,8 @@ void exportDevice(const std::string& type,
         if (keyPair.key() == "Name" &&
             keyPair.value().type() == nlohmann::json::value_t::string)
         {
-            subsituteString = std::regex_replace(
-                keyPair.value().get<std::string>(), illegalNameRegex, "_");
+            subsituteString = sanitizeDbusName(
+                keyPair.value().get_ref<const std::string&>());
             name = subsituteString;
         }
         else
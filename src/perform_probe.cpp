@@ -27,13 +27,13 @@ constexpr const bool debug = false;
 // When an interface passes a probe, also save its D-Bus path with it.
 bool probeDbus(const std::string& interfaceName,
                const std::map<std::string, nlohmann::json>& matches,
-               FoundDevices& devices, const std::shared_ptr<PerformScan>& scan,
+               FoundDevices& devices, const PerformScan& scan,
                bool& foundProbe)
 {
     bool foundMatch = false;
     foundProbe = false;
 
-    for (const auto& [path, interfaces] : scan->dbusProbeObjects)
+    for (const auto& [path, interfaces] : scan.dbusProbeObjects)
     {
         auto it = interfaces.find(interfaceName);
         if (it == interfaces.end())
@@ -78,7 +78,7 @@ bool probeDbus(const std::string& interfaceName,
 // default probe entry point, iterates a list looking for specific types to
 // call specific probe functions
 bool probe(const std::vector<std::string>& probeCommand,
-           const std::shared_ptr<PerformScan>& scan, FoundDevices& foundDevs)
+           const PerformScan& scan, FoundDevices& foundDevs)
 {
     const static std::regex command(R"(\((.*)\))");
     std::smatch match;
@@ -129,9 +129,9 @@ bool probe(const std::vector<std::string>& probeCommand,
                     }
                     std::string commandStr = *(match.begin() + 1);
                     boost::replace_all(commandStr, "'", "");
-                    cur = (std::find(scan->passedProbes.begin(),
-                                     scan->passedProbes.end(),
-                                     commandStr) != scan->passedProbes.end());
+                    cur = (std::find(scan.passedProbes.begin(),
+                                     scan.passedProbes.end(),
+                                     commandStr) != scan.passedProbes.end());
                     break;
                 }
                 default:
@@ -210,19 +210,3 @@ bool probe(const std::vector<std::string>& probeCommand,
     }
     return ret;
 }
-
-PerformProbe::PerformProbe(nlohmann::json& recordRef,
-                           const std::vector<std::string>& probeCommand,
-                           std::string probeName,
-                           std::shared_ptr<PerformScan>& scanPtr) :
-    recordRef(recordRef),
-    _probeCommand(probeCommand), probeName(std::move(probeName)), scan(scanPtr)
-{}
-PerformProbe::~PerformProbe()
-{
-    FoundDevices foundDevs;
-    if (probe(_probeCommand, scan, foundDevs))
-    {
-        scan->updateSystemConfiguration(recordRef, probeName, foundDevs);
-    }
-}
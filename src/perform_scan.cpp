@@ -16,17 +16,28 @@
 /// \file perform_scan.cpp
 #include "entity_manager.hpp"
 
+#include "scan_statistics.hpp"
+
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 
+#include <systemd/sd-bus.h>
+
 #include <charconv>
+#include <thread>
 
 /* Hacks from splitting entity_manager.cpp */
 // NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
 extern std::shared_ptr<sdbusplus::asio::connection> systemBus;
+extern ScanStatistics scanStatistics;
 extern nlohmann::json lastJson;
+extern ExposeNameIndex exposeIndex;
 extern void
     propertiesChangedCallback(nlohmann::json& systemConfiguration,
                               sdbusplus::asio::object_server& objServer);
@@ -37,6 +48,16 @@ using GetSubTreeType = std::vector<
               std::vector<std::pair<std::string, std::vector<std::string>>>>>;
 
 constexpr const int32_t maxMapperDepth = 0;
+constexpr const char* mapperBusName = "xyz.openbmc_project.ObjectMapper";
+constexpr const char* mapperInterface = "xyz.openbmc_project.ObjectMapper";
+
+// How long a scan may wait on D-Bus providers before it publishes what it has.
+constexpr std::chrono::milliseconds scanDeadline(SCAN_DEADLINE_MS);
+// Failed calls are retried often enough that a whole retry chain fits in the
+// deadline, so only a provider that fails for all of it leaves a retry to the
+// follow-up scan.
+constexpr std::chrono::milliseconds mapperRetryDelay = scanDeadline / 4;
+constexpr std::chrono::milliseconds getAllRetryDelay = scanDeadline / 8;
 
 constexpr const bool debug = false;
 
@@ -47,37 +68,165 @@ struct DBusInterfaceInstance
     std::string interface;
 };
 
-void getInterfaces(
-    const DBusInterfaceInstance& instance,
-    const std::vector<std::shared_ptr<PerformProbe>>& probeVector,
-    const std::shared_ptr<PerformScan>& scan, size_t retries = 5)
+// The D-Bus fetches of a single scan pass.  Every outstanding call or retry
+// timer counts as one operation, and the pass stops waiting on done once the
+// last of them has finished or the scan is cancelled.  Replies that arrive
+// with data after that, and retries that were still pending, are dropped and
+// instead request one follow-up scan.  That is a full, debounced rescan, but
+// it only publishes what changed.  Late errors are dropped outright, as a
+// wedged provider only fails at the D-Bus timeout, well past the deadline, and
+// would otherwise keep requesting scans.
+struct ScanFetch
+{
+    explicit ScanFetch(PerformScan& scan) :
+        systemConfiguration(scan._systemConfiguration),
+        objServer(scan.objServer), projection(scan.projection), done(io)
+    {}
+
+    void begin()
+    {
+        outstanding++;
+    }
+
+    void end()
+    {
+        outstanding--;
+        if (outstanding == 0U)
+        {
+            done.cancel();
+        }
+    }
+
+    void lateArrival()
+    {
+        if (followUpRequested)
+        {
+            return;
+        }
+        followUpRequested = true;
+        propertiesChangedCallback(systemConfiguration, objServer);
+    }
+
+    nlohmann::json& systemConfiguration;
+    sdbusplus::asio::object_server& objServer;
+    // only valid while the fetch hasn't expired
+    const PropertyProjection& projection;
+    MapperGetSubTreeResponse objects;
+    boost::asio::steady_timer done;
+    size_t outstanding = 0;
+    bool expired = false;
+    bool followUpRequested = false;
+};
+
+// Decodes a GetAll reply, skipping over the properties the projection has no
+// use for without materializing them.
+static bool readProjectedProperties(sdbusplus::message_t& reply,
+                                    const std::string& interface,
+                                    const PropertyProjection& projection,
+                                    DBusInterface& properties)
+{
+    sd_bus_message* msg = reply.get();
+    int ret = sd_bus_message_enter_container(msg, SD_BUS_TYPE_ARRAY, "{sv}");
+    if (ret < 0)
+    {
+        return false;
+    }
+    while ((ret = sd_bus_message_enter_container(msg, SD_BUS_TYPE_DICT_ENTRY,
+                                                 "sv")) > 0)
+    {
+        const char* name = nullptr;
+        ret = sd_bus_message_read_basic(msg, SD_BUS_TYPE_STRING, &name);
+        if (ret < 0)
+        {
+            return false;
+        }
+        if (projection.wantsProperty(interface, name))
+        {
+            DBusValueVariant value;
+            reply.read(value);
+            properties.insert_or_assign(name, std::move(value));
+        }
+        else
+        {
+            ret = sd_bus_message_skip(msg, "v");
+            if (ret < 0)
+            {
+                return false;
+            }
+        }
+        ret = sd_bus_message_exit_container(msg);
+        if (ret < 0)
+        {
+            return false;
+        }
+    }
+    if (ret < 0)
+    {
+        return false;
+    }
+    return sd_bus_message_exit_container(msg) >= 0;
+}
+
+static void getInterfaces(const DBusInterfaceInstance& instance,
+                          const std::shared_ptr<ScanFetch>& fetch,
+                          size_t retries = 5)
 {
     if (retries == 0U)
     {
         std::cerr << "retries exhausted on " << instance.busName << " "
                   << instance.path << " " << instance.interface << "\n";
+        fetch->end();
         return;
     }
 
+    auto start = std::chrono::steady_clock::now();
     systemBus->async_method_call(
-        [instance, scan, probeVector, retries](boost::system::error_code& errc,
-                                               const DBusInterface& resp) {
+        [instance, fetch, retries, start](boost::system::error_code& errc,
+                                          sdbusplus::message_t& reply) {
+        scanStatistics.record(instance.busName, instance.interface, "GetAll",
+                              std::chrono::steady_clock::now() - start,
+                              static_cast<bool>(errc));
+        if (fetch->expired)
+        {
+            if (!errc)
+            {
+                fetch->lateArrival();
+            }
+            return;
+        }
+
         if (errc)
         {
             std::cerr << "error calling getall on  " << instance.busName << " "
                       << instance.path << " " << instance.interface << "\n";
 
             auto timer = std::make_shared<boost::asio::steady_timer>(io);
-            timer->expires_after(std::chrono::seconds(2));
+            timer->expires_after(getAllRetryDelay);
 
-            timer->async_wait([timer, instance, scan, probeVector,
+            timer->async_wait([timer, instance, fetch,
                                retries](const boost::system::error_code&) {
-                getInterfaces(instance, probeVector, scan, retries - 1);
+                if (fetch->expired)
+                {
+                    fetch->lateArrival();
+                    return;
+                }
+                scanStatistics.retry(instance.busName, instance.interface,
+                                     "GetAll");
+                getInterfaces(instance, fetch, retries - 1);
             });
             return;
         }
 
-        scan->dbusProbeObjects[instance.path][instance.interface] = resp;
+        DBusInterface& properties =
+            fetch->objects[instance.path][instance.interface];
+        if (!readProjectedProperties(reply, instance.interface,
+                                     fetch->projection, properties))
+        {
+            std::cerr << "error decoding getall reply from "
+                      << instance.busName << " " << instance.path << " "
+                      << instance.interface << "\n";
+        }
+        fetch->end();
     },
         instance.busName, instance.path, "org.freedesktop.DBus.Properties",
         "GetAll", instance.interface);
@@ -113,15 +262,13 @@ static void registerCallback(nlohmann::json& systemConfiguration,
     dbusMatches.emplace(path, std::move(match));
 }
 
-static void
-    processDbusObjects(std::vector<std::shared_ptr<PerformProbe>>& probeVector,
-                       const std::shared_ptr<PerformScan>& scan,
-                       const GetSubTreeType& interfaceSubtree)
+static void processDbusObjects(const std::shared_ptr<ScanFetch>& fetch,
+                               const GetSubTreeType& interfaceSubtree)
 {
     for (const auto& [path, object] : interfaceSubtree)
     {
         // Get a PropertiesChanged callback for all interfaces on this path.
-        registerCallback(scan->_systemConfiguration, scan->objServer, path);
+        registerCallback(fetch->systemConfiguration, fetch->objServer, path);
 
         for (const auto& [busname, ifaces] : object)
         {
@@ -131,44 +278,55 @@ static void
                 // Introspectable, and Properties) are returned by
                 // the mapper but don't have properties, so don't bother
                 // with the GetAll call to save some cycles.
-                if (!boost::algorithm::starts_with(iface, "org.freedesktop"))
+                if (boost::algorithm::starts_with(iface, "org.freedesktop"))
                 {
-                    getInterfaces({busname, path, iface}, probeVector, scan);
+                    continue;
                 }
+                // Nothing on this interface is of any use, so record it as
+                // present without asking for its properties.
+                if (!fetch->projection.wantsInterface(iface))
+                {
+                    fetch->objects[path].try_emplace(iface);
+                    continue;
+                }
+                fetch->begin();
+                getInterfaces({busname, path, iface}, fetch);
             }
         }
     }
 }
 
-// Populates scan->dbusProbeObjects with all interfaces and properties
-// for the paths that own the interfaces passed in.
-void findDbusObjects(std::vector<std::shared_ptr<PerformProbe>>&& probeVector,
-                     boost::container::flat_set<std::string>&& interfaces,
-                     const std::shared_ptr<PerformScan>& scan,
-                     size_t retries = 5)
+// Populates fetch->objects with all interfaces and properties for the paths
+// that own the interfaces passed in.
+static void
+    findDbusObjects(const std::shared_ptr<ScanFetch>& fetch,
+                    boost::container::flat_set<std::string>&& interfaces,
+                    size_t retries = 5)
 {
-    // Filter out interfaces already obtained.
-    for (const auto& [path, probeInterfaces] : scan->dbusProbeObjects)
-    {
-        for (const auto& [interface, _] : probeInterfaces)
+    // find all connections in the mapper that expose a specific type
+    auto start = std::chrono::steady_clock::now();
+    systemBus->async_method_call(
+        [interfaces, fetch, retries,
+         start](boost::system::error_code& ec,
+                const GetSubTreeType& interfaceSubtree) mutable {
+        // the mapper answering ENOENT isn't a failure, just an empty subtree
+        scanStatistics.record(mapperBusName, mapperInterface, "GetSubTree",
+                              std::chrono::steady_clock::now() - start,
+                              ec && ec.value() != ENOENT);
+        if (fetch->expired)
         {
-            interfaces.erase(interface);
+            if (!ec && !interfaceSubtree.empty())
+            {
+                fetch->lateArrival();
+            }
+            return;
         }
-    }
-    if (interfaces.empty())
-    {
-        return;
-    }
 
-    // find all connections in the mapper that expose a specific type
-    systemBus->async_method_call(
-        [interfaces, probeVector{std::move(probeVector)}, scan,
-         retries](boost::system::error_code& ec,
-                  const GetSubTreeType& interfaceSubtree) mutable {
         if (ec)
         {
             if (ec.value() == ENOENT)
             {
+                fetch->end();
                 return; // wasn't found by mapper
             }
             std::cerr << "Error communicating to mapper.\n";
@@ -181,23 +339,28 @@ void findDbusObjects(std::vector<std::shared_ptr<PerformProbe>>&& probeVector,
             }
 
             auto timer = std::make_shared<boost::asio::steady_timer>(io);
-            timer->expires_after(std::chrono::seconds(10));
+            timer->expires_after(mapperRetryDelay);
 
-            timer->async_wait([timer, interfaces{std::move(interfaces)}, scan,
-                               probeVector{std::move(probeVector)}, retries](
-                                  const boost::system::error_code&) mutable {
-                findDbusObjects(std::move(probeVector), std::move(interfaces),
-                                scan, retries - 1);
+            timer->async_wait(
+                [timer, interfaces{std::move(interfaces)}, fetch,
+                 retries](const boost::system::error_code&) mutable {
+                if (fetch->expired)
+                {
+                    fetch->lateArrival();
+                    return;
+                }
+                scanStatistics.retry(mapperBusName, mapperInterface,
+                                     "GetSubTree");
+                findDbusObjects(fetch, std::move(interfaces), retries - 1);
             });
             return;
         }
 
-        processDbusObjects(probeVector, scan, interfaceSubtree);
+        processDbusObjects(fetch, interfaceSubtree);
+        fetch->end();
     },
-        "xyz.openbmc_project.ObjectMapper",
-        "/xyz/openbmc_project/object_mapper",
-        "xyz.openbmc_project.ObjectMapper", "GetSubTree", "/", maxMapperDepth,
-        interfaces);
+        mapperBusName, "/xyz/openbmc_project/object_mapper", mapperInterface,
+        "GetSubTree", "/", maxMapperDepth, interfaces);
 
     if constexpr (debug)
     {
@@ -205,45 +368,86 @@ void findDbusObjects(std::vector<std::shared_ptr<PerformProbe>>&& probeVector,
     }
 }
 
-static std::string getRecordName(const DBusInterface& probe,
-                                 const std::string& probeName)
+boost::asio::awaitable<void>
+    PerformScan::fetch(boost::container::flat_set<std::string> interfaces)
 {
-    if (probe.empty())
+    // Filter out interfaces already obtained.
+    for (const auto& [path, probeInterfaces] : dbusProbeObjects)
+    {
+        for (const auto& [interface, _] : probeInterfaces)
+        {
+            interfaces.erase(interface);
+        }
+    }
+    if (interfaces.empty() || _cancelled)
     {
-        return probeName;
+        co_return;
     }
 
-    // use an array so alphabetical order from the flat_map is maintained
-    auto device = nlohmann::json::array();
-    for (const auto& devPair : probe)
+    auto fetch = std::make_shared<ScanFetch>(*this);
+    currentFetch = fetch;
+
+    fetch->begin();
+    findDbusObjects(fetch, std::move(interfaces));
+
+    fetch->done.expires_at(std::chrono::steady_clock::time_point::max());
+    boost::system::error_code ec;
+    co_await fetch->done.async_wait(
+        boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+
+    if (fetch->outstanding != 0U)
     {
-        device.push_back(devPair.first);
-        std::visit([&device](auto&& v) { device.push_back(v); },
-                   devPair.second);
+        std::cerr << "Scan cancelled with " << fetch->outstanding
+                  << " D-Bus calls outstanding, continuing with what has "
+                     "been found\n";
+        fetch->expired = true;
     }
 
-    // hashes are hard to distinguish, use the non-hashed version if we want
-    // debug
-    if constexpr (debug)
+    for (auto& [path, object] : fetch->objects)
     {
-        return probeName + device.dump();
+        for (auto& [interface, properties] : object)
+        {
+            dbusProbeObjects[path][interface] = std::move(properties);
+        }
     }
+    fetch->objects.clear();
+}
 
-    return std::to_string(std::hash<std::string>{}(probeName + device.dump()));
+// Finds a record persisted under the name used before record names were
+// versioned, and renames it to the current name.
+static nlohmann::json::iterator
+    migrateLegacyRecord(const DBusInterface& probe,
+                        const std::string& probeName,
+                        const std::string& recordName)
+{
+    if (lastJson.empty() || probe.empty())
+    {
+        return lastJson.end();
+    }
+
+    auto legacy = lastJson.find(getLegacyRecordName(probe, probeName));
+    if (legacy == lastJson.end())
+    {
+        return lastJson.end();
+    }
+
+    nlohmann::json record = std::move(*legacy);
+    lastJson.erase(legacy);
+    return lastJson.emplace(recordName, std::move(record)).first;
 }
 
 PerformScan::PerformScan(nlohmann::json& systemConfiguration,
                          nlohmann::json& missingConfigurations,
-                         std::list<nlohmann::json>& configurations,
+                         std::list<nlohmann::json>&& configurations,
                          sdbusplus::asio::object_server& objServerIn,
-                         std::function<void()>&& callback) :
+                         std::function<void(bool complete)>&& callback) :
     _systemConfiguration(systemConfiguration),
     _missingConfigurations(missingConfigurations),
-    _configurations(configurations), objServer(objServerIn),
-    _callback(std::move(callback))
+    _configurations(std::move(configurations)), objServer(objServerIn),
+    _callback(std::move(callback)), deadlineTimer(io)
 {}
 
-static void pruneRecordExposes(nlohmann::json& record)
+void pruneRecordExposes(nlohmann::json& record)
 {
     auto findExposes = record.find("Exposes");
     if (findExposes == record.end())
@@ -251,15 +455,15 @@ static void pruneRecordExposes(nlohmann::json& record)
         return;
     }
 
-    auto copy = nlohmann::json::array();
-    for (auto& expose : *findExposes)
+    if (!findExposes->is_array())
     {
-        if (!expose.is_null())
-        {
-            copy.emplace_back(expose);
-        }
+        return;
     }
-    *findExposes = copy;
+
+    auto& exposes = findExposes->get_ref<nlohmann::json::array_t&>();
+    std::erase_if(exposes, [](const nlohmann::json& expose) {
+        return expose.is_null();
+    });
 }
 
 static void recordDiscoveredIdentifiers(std::set<nlohmann::json>& usedNames,
@@ -328,22 +532,6 @@ static bool extractExposeActionRecordNames(std::vector<std::string>& matches,
     return false;
 }
 
-static std::optional<std::vector<std::string>::iterator>
-    findExposeActionRecord(std::vector<std::string>& matches,
-                           const nlohmann::json& record)
-{
-    const auto& name = (record)["Name"].get_ref<const std::string&>();
-    auto compare = [&name](const std::string& s) { return s == name; };
-    auto matchIt = std::find_if(matches.begin(), matches.end(), compare);
-
-    if (matchIt == matches.end())
-    {
-        return std::nullopt;
-    }
-
-    return matchIt;
-}
-
 static void applyBindExposeAction(nlohmann::json& exposedObject,
                                   nlohmann::json& expose,
                                   const std::string& propertyName)
@@ -365,24 +553,35 @@ static void applyDisableExposeAction(nlohmann::json& exposedObject,
     }
 }
 
-static void applyConfigExposeActions(std::vector<std::string>& matches,
-                                     nlohmann::json& expose,
-                                     const std::string& propertyName,
-                                     nlohmann::json& configExposes)
+// Resolves an index location, which is stale if the system configuration was
+// changed behind the index's back.
+static nlohmann::json*
+    findIndexedExpose(nlohmann::json& systemConfiguration,
+                      const ExposeNameIndex::Location& location,
+                      const std::string& name)
 {
-    for (auto& exposedObject : configExposes)
+    auto record = systemConfiguration.find(location.first);
+    if (record == systemConfiguration.end())
     {
-        auto match = findExposeActionRecord(matches, exposedObject);
-        if (match)
-        {
-            matches.erase(*match);
-            applyBindExposeAction(exposedObject, expose, propertyName);
-            applyDisableExposeAction(exposedObject, propertyName);
-        }
+        return nullptr;
+    }
+    auto exposes = record->find("Exposes");
+    if (exposes == record->end() || !exposes->is_array() ||
+        location.second >= exposes->size())
+    {
+        return nullptr;
+    }
+    nlohmann::json& exposedObject = (*exposes)[location.second];
+    auto findName = exposedObject.find("Name");
+    if (findName == exposedObject.end() || *findName != name)
+    {
+        return nullptr;
     }
+    return &exposedObject;
 }
 
 static void applyExposeActions(nlohmann::json& systemConfiguration,
+                               const ExposeNameIndex& exposeIndex,
                                const std::string& recordName,
                                nlohmann::json& expose,
                                nlohmann::json::iterator& keyPair)
@@ -403,30 +602,41 @@ static void applyExposeActions(nlohmann::json& systemConfiguration,
         return;
     }
 
-    for (const auto& [configId, config] : systemConfiguration.items())
+    // Each match takes the first expose of that name not taken already, and
+    // the actions are applied in system configuration order.
+    std::map<ExposeNameIndex::Location, nlohmann::json*> hits;
+    bool missing = false;
+    for (const std::string& name : matches)
     {
-        // don't disable ourselves
-        if (isDisable && configId == recordName)
-        {
-            continue;
-        }
-
-        auto configListFind = config.find("Exposes");
-        if (configListFind == config.end())
+        bool found = false;
+        for (const ExposeNameIndex::Location& location :
+             exposeIndex.find(name))
         {
-            continue;
-        }
-
-        if (!configListFind->is_array())
-        {
-            continue;
+            // don't disable ourselves
+            if ((isDisable && location.first == recordName) ||
+                hits.contains(location))
+            {
+                continue;
+            }
+            nlohmann::json* exposedObject =
+                findIndexedExpose(systemConfiguration, location, name);
+            if (exposedObject != nullptr)
+            {
+                hits.emplace(location, exposedObject);
+                found = true;
+                break;
+            }
         }
+        missing = missing || !found;
+    }
 
-        applyConfigExposeActions(matches, expose, keyPair.key(),
-                                 *configListFind);
+    for (const auto& [_, exposedObject] : hits)
+    {
+        applyBindExposeAction(*exposedObject, expose, keyPair.key());
+        applyDisableExposeAction(*exposedObject, keyPair.key());
     }
 
-    if (!matches.empty())
+    if (missing)
     {
         std::cerr << "configuration file dependency error, could not find "
                   << keyPair.key() << " " << keyPair.value() << "\n";
@@ -465,11 +675,201 @@ static std::string generateDeviceName(const std::set<nlohmann::json>& usedNames,
     return copyIt.value();
 }
 
-void PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
-                                            const std::string& probeName,
-                                            FoundDevices& foundDevices)
+// A configuration record prepared for instantiating once per found device.
+// nlohmann::json values can't share structure, so each instance is still a
+// copy of the record, but the strings that don't depend on the device are
+// converted once here and only the values that hold a template, or an expose
+// action, are visited per device.
+struct RecordTemplate
+{
+    explicit RecordTemplate(const nlohmann::json& recordRef);
+
+    nlohmann::json record;
+    // top level keys, other than Name, holding a template
+    std::vector<std::string> templatedKeys;
+    // per Exposes entry, the keys holding a template or an expose action
+    std::vector<std::vector<std::string>> exposeKeys;
+    bool hasExposeActions = false;
+};
+
+// Converts the strings below keyPair that don't hold a template as expansion
+// would, and returns whether any of them do.
+static bool prepareTemplate(nlohmann::json::iterator& keyPair)
+{
+    nlohmann::json& value = keyPair.value();
+    if (value.is_object() || value.is_array())
+    {
+        bool templated = false;
+        for (auto it = value.begin(); it != value.end(); it++)
+        {
+            templated = prepareTemplate(it) || templated;
+        }
+        return templated;
+    }
+
+    const std::string* strPtr = value.get_ptr<const std::string*>();
+    if (strPtr == nullptr)
+    {
+        return false;
+    }
+    if (strPtr->find('$') != std::string::npos)
+    {
+        return true;
+    }
+
+    // without a template all expansion does is convert numbers
+    static const DBusInterface noProperties;
+    templateCharReplace(keyPair, noProperties, 0);
+    return false;
+}
+
+static bool isExposeAction(const std::string& key)
+{
+    return boost::starts_with(key, "Bind") || key == "DisableNode";
+}
+
+RecordTemplate::RecordTemplate(const nlohmann::json& recordRef) :
+    record(recordRef)
+{
+    for (auto keyPair = record.begin(); keyPair != record.end(); keyPair++)
+    {
+        if (keyPair.key() != "Name" && prepareTemplate(keyPair))
+        {
+            templatedKeys.push_back(keyPair.key());
+        }
+    }
+
+    auto findExpose = record.find("Exposes");
+    if (findExpose == record.end())
+    {
+        return;
+    }
+    for (auto& expose : *findExpose)
+    {
+        std::vector<std::string>& keys = exposeKeys.emplace_back();
+        if (!expose.is_object())
+        {
+            continue;
+        }
+        for (auto keyPair = expose.begin(); keyPair != expose.end(); keyPair++)
+        {
+            bool action = isExposeAction(keyPair.key());
+            hasExposeActions = hasExposeActions || action;
+            if (action || prepareTemplate(keyPair))
+            {
+                keys.push_back(keyPair.key());
+            }
+        }
+    }
+}
+
+// One found device's record, on its way from the record template into the
+// system configuration.
+struct DeviceExpansion
+{
+    nlohmann::json record;
+    std::string recordName;
+    const DBusObject* dbusObject;
+    size_t index;
+    // duplicate name handling in effect when the device was named
+    std::optional<std::string> replaceStr;
+};
+
+// Substitutes the templates of one device's record.  Only reads state shared
+// with other devices, so expansions can run in parallel.
+static void expandDeviceTemplates(const RecordTemplate& recordTemplate,
+                                  DeviceExpansion& device)
+{
+    for (const std::string& key : recordTemplate.templatedKeys)
+    {
+        auto keyPair = device.record.find(key);
+        templateCharReplace(keyPair, *device.dbusObject, device.index,
+                            device.replaceStr);
+    }
+
+    auto findExpose = device.record.find("Exposes");
+    if (findExpose == device.record.end())
+    {
+        return;
+    }
+
+    auto exposeKeys = recordTemplate.exposeKeys.begin();
+    for (auto& expose : *findExpose)
+    {
+        for (const std::string& key : *exposeKeys++)
+        {
+            auto keyPair = expose.find(key);
+            templateCharReplace(keyPair, *device.dbusObject, device.index,
+                                device.replaceStr);
+        }
+    }
+}
+
+static boost::asio::thread_pool& expansionPool()
+{
+    static boost::asio::thread_pool pool(
+        std::max(1U, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+// Expands the devices on the expansion pool, resuming on the io thread once
+// all of them are done so that D-Bus is serviced meanwhile.
+static boost::asio::awaitable<void>
+    expandDevices(const RecordTemplate& recordTemplate,
+                  std::vector<DeviceExpansion>& devices)
+{
+    if (devices.size() < 2)
+    {
+        for (DeviceExpansion& device : devices)
+        {
+            expandDeviceTemplates(recordTemplate, device);
+        }
+        co_return;
+    }
+
+    boost::asio::steady_timer done(io);
+    done.expires_at(boost::asio::steady_timer::time_point::max());
+    size_t remaining = devices.size();
+    std::vector<std::exception_ptr> errors(devices.size());
+
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        boost::asio::post(expansionPool(), [&, i]() {
+            try
+            {
+                expandDeviceTemplates(recordTemplate, devices[i]);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+            boost::asio::post(io, [&]() {
+                if (--remaining == 0)
+                {
+                    done.cancel();
+                }
+            });
+        });
+    }
+
+    boost::system::error_code ec;
+    co_await done.async_wait(
+        boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+
+    for (const std::exception_ptr& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+boost::asio::awaitable<void>
+    PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
+                                           const std::string& probeName,
+                                           FoundDevices& foundDevices)
 {
-    _passed = true;
     passedProbes.push_back(probeName);
 
     std::set<nlohmann::json> usedNames;
@@ -487,6 +887,11 @@ void PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
         {
             record = lastJson.find(recordName);
             if (record == lastJson.end())
+            {
+                record = migrateLegacyRecord(itr->interface, probeName,
+                                             recordName);
+            }
+            if (record == lastJson.end())
             {
                 itr++;
                 continue;
@@ -495,6 +900,7 @@ void PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
             pruneRecordExposes(*record);
 
             _systemConfiguration[recordName] = *record;
+            exposeIndex.addRecord(recordName, *record);
         }
         _missingConfigurations.erase(recordName);
 
@@ -504,12 +910,22 @@ void PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
         recordDiscoveredIdentifiers(usedNames, indexes, probeName, *record);
     }
 
+    if (foundDevices.empty())
+    {
+        co_return;
+    }
+
+    RecordTemplate recordTemplate(recordRef);
     std::optional<std::string> replaceStr;
 
     DBusObject emptyObject;
     DBusInterface emptyInterface;
     emptyObject.emplace(std::string{}, emptyInterface);
 
+    // Naming and merging stay in device order on the io thread, only the
+    // template substitution in between is done in parallel.
+    std::vector<DeviceExpansion> devices;
+    devices.reserve(foundDevices.size());
     for (const auto& [foundDevice, path] : foundDevices)
     {
         // Need all interfaces on this path so that template
@@ -523,7 +939,7 @@ void PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
                                            ? emptyObject
                                            : objectIt->second;
 
-        nlohmann::json record = recordRef;
+        nlohmann::json record = recordTemplate.record;
         std::string recordName = getRecordName(foundDevice, probeName);
         size_t foundDeviceIdx = indexes.front();
         indexes.pop_front();
@@ -541,58 +957,80 @@ void PerformScan::updateSystemConfiguration(const nlohmann::json& recordRef,
         getName.value() = deviceName;
         usedNames.insert(deviceName);
 
-        for (auto keyPair = record.begin(); keyPair != record.end(); keyPair++)
-        {
-            if (keyPair.key() != "Name")
-            {
-                templateCharReplace(keyPair, dbusObject, foundDeviceIdx,
-                                    replaceStr);
-            }
-        }
+        devices.push_back({std::move(record), std::move(recordName),
+                           &dbusObject, foundDeviceIdx, replaceStr});
+    }
 
-        // insert into configuration temporarily to be able to
-        // reference ourselves
+    co_await expandDevices(recordTemplate, devices);
 
-        _systemConfiguration[recordName] = record;
+    for (DeviceExpansion& device : devices)
+    {
+        nlohmann::json& record = device.record;
+        const std::string& recordName = device.recordName;
+
+        // insert into configuration temporarily to be able to
+        // reference ourselves.  Only expose actions look.
+        if (recordTemplate.hasExposeActions)
+        {
+            _systemConfiguration[recordName] = record;
+            exposeIndex.addRecord(recordName, record);
+        }
 
         auto findExpose = record.find("Exposes");
         if (findExpose == record.end())
         {
+            exposeIndex.removeRecord(recordName);
+            _systemConfiguration[recordName] = std::move(record);
             continue;
         }
 
-        for (auto& expose : *findExpose)
+        if (recordTemplate.hasExposeActions)
         {
-            for (auto keyPair = expose.begin(); keyPair != expose.end();
-                 keyPair++)
+            auto exposeKeys = recordTemplate.exposeKeys.begin();
+            for (auto& expose : *findExpose)
             {
-                templateCharReplace(keyPair, dbusObject, foundDeviceIdx,
-                                    replaceStr);
-
-                applyExposeActions(_systemConfiguration, recordName, expose,
-                                   keyPair);
+                for (const std::string& key : *exposeKeys++)
+                {
+                    if (!isExposeAction(key))
+                    {
+                        continue;
+                    }
+                    auto keyPair = expose.find(key);
+                    applyExposeActions(_systemConfiguration, exposeIndex,
+                                       recordName, expose, keyPair);
+                }
             }
         }
 
         // overwrite ourselves with cleaned up version
-        _systemConfiguration[recordName] = record;
+        exposeIndex.addRecord(recordName, record);
+        _systemConfiguration[recordName] = std::move(record);
         _missingConfigurations.erase(recordName);
     }
 }
 
-void PerformScan::run()
+struct ScanProbe
 {
-    boost::container::flat_set<std::string> dbusProbeInterfaces;
-    std::vector<std::shared_ptr<PerformProbe>> dbusProbePointers;
+    const nlohmann::json* record;
+    std::vector<std::string> command;
+    std::string name;
+};
 
-    for (auto it = _configurations.begin(); it != _configurations.end();)
+// Drops configurations that are malformed or have already been found, and
+// collects the probes of the rest along with the D-Bus interfaces they need.
+static void collectProbes(std::list<nlohmann::json>& configurations,
+                          const std::vector<std::string>& passedProbes,
+                          std::vector<ScanProbe>& probes,
+                          boost::container::flat_set<std::string>& interfaces)
+{
+    for (auto it = configurations.begin(); it != configurations.end();)
     {
         // check for poorly formatted fields, probe must be an array
         auto findProbe = it->find("Probe");
         if (findProbe == it->end())
         {
             std::cerr << "configuration file missing probe:\n " << *it << "\n";
-            it = _configurations.erase(it);
+            it = configurations.erase(it);
             continue;
         }
 
@@ -600,7 +1038,7 @@ void PerformScan::run()
         if (findName == it->end())
         {
             std::cerr << "configuration file missing name:\n " << *it << "\n";
-            it = _configurations.erase(it);
+            it = configurations.erase(it);
             continue;
         }
         std::string probeName = *findName;
@@ -608,31 +1046,22 @@ void PerformScan::run()
         if (std::find(passedProbes.begin(), passedProbes.end(), probeName) !=
             passedProbes.end())
         {
-            it = _configurations.erase(it);
+            it = configurations.erase(it);
             continue;
         }
 
-        nlohmann::json& recordRef = *it;
-        nlohmann::json probeCommand;
-        if ((*findProbe).type() != nlohmann::json::value_t::array)
+        const nlohmann::json* probeCommand = &*findProbe;
+        nlohmann::json probeArray;
+        if (findProbe->type() != nlohmann::json::value_t::array)
         {
-            probeCommand = nlohmann::json::array();
-            probeCommand.push_back(*findProbe);
-        }
-        else
-        {
-            probeCommand = *findProbe;
+            probeArray = nlohmann::json::array({*findProbe});
+            probeCommand = &probeArray;
         }
 
-        // store reference to this to children to makes sure we don't get
-        // destroyed too early
-        auto thisRef = shared_from_this();
-        auto probePointer = std::make_shared<PerformProbe>(
-            recordRef, probeCommand, probeName, thisRef);
+        ScanProbe scanProbe{&*it, {}, std::move(probeName)};
 
-        // parse out dbus probes by discarding other probe types, store in a
-        // map
-        for (const nlohmann::json& probeJson : probeCommand)
+        // parse out dbus probes by discarding other probe types
+        for (const nlohmann::json& probeJson : *probeCommand)
         {
             const std::string* probe = probeJson.get_ptr<const std::string*>();
             if (probe == nullptr)
@@ -640,6 +1069,7 @@ void PerformScan::run()
                 std::cerr << "Probe statement wasn't a string, can't parse";
                 continue;
             }
+            scanProbe.command.emplace_back(*probe);
             if (findProbeType(*probe))
             {
                 continue;
@@ -647,45 +1077,137 @@ void PerformScan::run()
             // syntax requires probe before first open brace
             auto findStart = probe->find('(');
             std::string interface = probe->substr(0, findStart);
-            dbusProbeInterfaces.emplace(interface);
-            dbusProbePointers.emplace_back(probePointer);
+            interfaces.emplace(interface);
         }
+        probes.emplace_back(std::move(scanProbe));
         it++;
     }
+}
 
-    // probe vector stores a shared_ptr to each PerformProbe that cares
-    // about a dbus interface
-    findDbusObjects(std::move(dbusProbePointers),
-                    std::move(dbusProbeInterfaces), shared_from_this());
-    if constexpr (debug)
-    {
-        std::cerr << __LINE__ << "\n";
-    }
+using ScanClock = std::chrono::steady_clock;
+
+struct ScanStageTimes
+{
+    ScanClock::duration fetch{};
+    ScanClock::duration probe{};
+    ScanClock::duration expand{};
+    ScanClock::duration publish{};
+};
+
+static int64_t toMs(ScanClock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+        .count();
 }
 
-PerformScan::~PerformScan()
+static boost::asio::awaitable<void>
+    scanPipeline(std::shared_ptr<PerformScan> scan)
 {
-    if (_passed)
+    ScanStageTimes times;
+    ScanClock::time_point start = ScanClock::now();
+    ScanClock::time_point lapStart = start;
+    auto lap = [&lapStart]() {
+        ScanClock::time_point now = ScanClock::now();
+        ScanClock::duration elapsed = now - lapStart;
+        lapStart = now;
+        return elapsed;
+    };
+
+    // Probe statements don't reference templates, but everything else in the
+    // configuration can.
+    for (const nlohmann::json& configuration : scan->_configurations)
+    {
+        for (const auto& [key, value] : configuration.items())
+        {
+            if (key != "Probe")
+            {
+                scan->projection.addTemplateReferences(value);
+            }
+        }
+    }
+
+    size_t passes = 0;
+    bool passed = true;
+    while (passed)
     {
-        auto nextScan = std::make_shared<PerformScan>(
-            _systemConfiguration, _missingConfigurations, _configurations,
-            objServer, std::move(_callback));
-        nextScan->passedProbes = std::move(passedProbes);
-        nextScan->dbusProbeObjects = std::move(dbusProbeObjects);
-        nextScan->run();
+        passes++;
+        passed = false;
+
+        std::vector<ScanProbe> probes;
+        boost::container::flat_set<std::string> interfaces;
+        collectProbes(scan->_configurations, scan->passedProbes, probes,
+                      interfaces);
+        scan->projection.probedInterfaces.insert(interfaces.begin(),
+                                                 interfaces.end());
 
-        if constexpr (debug)
+        co_await scan->fetch(std::move(interfaces));
+        times.fetch += lap();
+
+        for (const ScanProbe& scanProbe : probes)
         {
-            std::cerr << __LINE__ << "\n";
+            FoundDevices foundDevs;
+            bool found = probe(scanProbe.command, *scan, foundDevs);
+            times.probe += lap();
+            if (!found)
+            {
+                continue;
+            }
+            co_await scan->updateSystemConfiguration(*scanProbe.record,
+                                                     scanProbe.name, foundDevs);
+            times.expand += lap();
+            passed = true;
         }
     }
-    else
+
+    scan->deadlineTimer.cancel();
+    scan->_callback(!scan->_cancelled);
+    times.publish += lap();
+
+    // Scans run on every inventory change, so the timings are only logged
+    // for a scan that has taken half its deadline or more.
+    if (debug || lapStart - start >= scanDeadline / 2)
     {
-        _callback();
+        std::cerr << "Scan finished in " << toMs(lapStart - start)
+                  << "ms over " << passes << " passes (fetch "
+                  << toMs(times.fetch) << "ms, probe " << toMs(times.probe)
+                  << "ms, expand " << toMs(times.expand) << "ms, publish "
+                  << toMs(times.publish) << "ms)\n";
+    }
+}
 
-        if constexpr (debug)
+void PerformScan::run()
+{
+    deadlineTimer.expires_after(scanDeadline);
+    deadlineTimer.async_wait(
+        [weakScan{weak_from_this()}](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
         {
-            std::cerr << __LINE__ << "\n";
+            return;
         }
+        std::shared_ptr<PerformScan> scan = weakScan.lock();
+        if (!scan)
+        {
+            return;
+        }
+        std::cerr << "Scan deadline expired, publishing what has been found\n";
+        scan->cancel();
+    });
+
+    boost::asio::co_spawn(io, scanPipeline(shared_from_this()),
+                          [](const std::exception_ptr& e) {
+        if (e)
+        {
+            std::rethrow_exception(e);
+        }
+    });
+}
+
+void PerformScan::cancel()
+{
+    _cancelled = true;
+    std::shared_ptr<ScanFetch> fetch = currentFetch.lock();
+    if (fetch)
+    {
+        fetch->done.cancel();
     }
 }
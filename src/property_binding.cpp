@@ -0,0 +1,89 @@
+#include "property_binding.hpp"
+
+#include <unordered_set>
+
+InterfaceBinding::InterfaceBinding(std::shared_ptr<RecordBinding> record,
+                                   const std::string& pointer,
+                                   std::string overridesKey) :
+    record(std::move(record)),
+    pointer(pointer), overridesKey(std::move(overridesKey))
+{}
+
+const nlohmann::json*
+    InterfaceBinding::find(const nlohmann::json& systemConfiguration,
+                           const std::string& name) const
+{
+    auto findRecord = systemConfiguration.find(record->recordName);
+    if (findRecord == systemConfiguration.end() ||
+        !findRecord->contains(pointer))
+    {
+        return nullptr;
+    }
+    const nlohmann::json& dict = findRecord->at(pointer);
+    if (!dict.is_object())
+    {
+        return nullptr;
+    }
+
+    if (!overridesKey.empty())
+    {
+        auto overrides = dict.find(overridesKey);
+        if (overrides != dict.end() && overrides->is_object())
+        {
+            auto value = overrides->find(name);
+            if (value != overrides->end())
+            {
+                return &*value;
+            }
+        }
+    }
+
+    auto value = dict.find(name);
+    if (value == dict.end())
+    {
+        return nullptr;
+    }
+    return &*value;
+}
+
+std::string InterfaceBinding::jsonPointer() const
+{
+    return "/" + record->recordName + pointer.to_string();
+}
+
+std::shared_ptr<RecordBinding>
+    RecordBindings::get(const std::string& recordName)
+{
+    std::shared_ptr<RecordBinding>& binding = bindings[recordName];
+    if (!binding)
+    {
+        binding = std::make_shared<RecordBinding>(RecordBinding{recordName});
+    }
+    return binding;
+}
+
+void RecordBindings::rename(const std::string& oldName,
+                            const std::string& newName)
+{
+    auto findBinding = bindings.find(oldName);
+    if (oldName == newName || findBinding == bindings.end())
+    {
+        return;
+    }
+    std::shared_ptr<RecordBinding> binding = std::move(findBinding->second);
+    bindings.erase(findBinding);
+    binding->recordName = newName;
+    bindings.insert_or_assign(newName, std::move(binding));
+}
+
+void RecordBindings::remove(const std::string& recordName)
+{
+    bindings.erase(recordName);
+}
+
+const std::string& internPropertyName(const std::string& name)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+    static std::unordered_set<std::string> names;
+    return *names.insert(name).first;
+}
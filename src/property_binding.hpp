@@ -0,0 +1,92 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/// \brief The record that published interfaces read their properties from.
+///
+/// All the interfaces of a record share one binding, so a record reconciled
+/// under a new name is rebound in a single place.
+struct RecordBinding
+{
+    std::string recordName;
+};
+
+/// \brief Where the properties of a published interface live in the system
+/// configuration.
+///
+/// Properties bound this way read their value from the system configuration
+/// on every Get instead of holding a copy of it.
+class InterfaceBinding
+{
+  public:
+    /// \param record the binding of the record the interface belongs to.
+    /// \param pointer JSON pointer to the interface's properties, relative to
+    /// the record.
+    /// \param overridesKey key of an object next to the properties whose
+    /// entries take the place of properties of the same name, if any.
+    InterfaceBinding(std::shared_ptr<RecordBinding> record,
+                     const std::string& pointer, std::string overridesKey = {});
+
+    /// \brief Find the current value of a property.
+    /// \return the value, or nullptr if the record or property is gone.
+    const nlohmann::json* find(const nlohmann::json& systemConfiguration,
+                               const std::string& name) const;
+
+    /// \return the JSON pointer to the interface's properties in the system
+    /// configuration.
+    std::string jsonPointer() const;
+
+  private:
+    std::shared_ptr<RecordBinding> record;
+    nlohmann::json::json_pointer pointer;
+    std::string overridesKey;
+};
+
+/// \brief The bindings of the records published on D-Bus, by record name.
+class RecordBindings
+{
+  public:
+    /// \return the binding of the record, created if it doesn't have one yet.
+    std::shared_ptr<RecordBinding> get(const std::string& recordName);
+
+    /// \brief Point the interfaces bound to a record at its new name.
+    void rename(const std::string& oldName, const std::string& newName);
+
+    void remove(const std::string& recordName);
+
+  private:
+    std::unordered_map<std::string, std::shared_ptr<RecordBinding>> bindings;
+};
+
+/// \brief Store a value set over D-Bus in the system configuration, and
+/// signal the change.
+///
+/// Bound properties read their value through the binding, so the value
+/// sdbusplus holds never changes and it doesn't signal the Set by itself.
+/// \param pointer JSON pointer to the property in the system configuration.
+/// \return false if the value couldn't be stored there.
+template <typename Interface, typename Value>
+bool writeBoundProperty(nlohmann::json& systemConfiguration,
+                        const std::string& pointer, Interface& iface,
+                        const std::string& name, const Value& value)
+{
+    try
+    {
+        systemConfiguration[nlohmann::json::json_pointer(pointer)] = value;
+    }
+    catch (const nlohmann::json::exception&)
+    {
+        return false;
+    }
+    iface.signal_property(name);
+    return true;
+}
+
+/// \brief Intern a property name, so that the properties bound to it share
+/// one copy.
+/// \return a reference that stays valid for the life of the process.
+const std::string& internPropertyName(const std::string& name);
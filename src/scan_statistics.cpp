@@ -0,0 +1,75 @@
+#include "scan_statistics.hpp"
+
+#include <algorithm>
+#include <bit>
+
+void ScanStatistics::record(const std::string& service,
+                            const std::string& interface,
+                            const std::string& method,
+                            std::chrono::steady_clock::duration latency,
+                            bool error)
+{
+    Entry& entry = stats[Key(service, interface, method)];
+    entry.calls++;
+    if (error)
+    {
+        entry.errors++;
+    }
+    entry.histogram[bucket(latency)]++;
+}
+
+void ScanStatistics::retry(const std::string& service,
+                           const std::string& interface,
+                           const std::string& method)
+{
+    stats[Key(service, interface, method)].retries++;
+}
+
+void ScanStatistics::recordPublishSlice(
+    std::chrono::steady_clock::duration held, size_t records)
+{
+    publish.slices++;
+    publish.records += records;
+    publish.histogram[bucket(held)]++;
+    publish.longestMicroseconds = std::max<uint64_t>(
+        publish.longestMicroseconds,
+        std::chrono::duration_cast<std::chrono::microseconds>(held).count());
+}
+
+size_t ScanStatistics::bucket(std::chrono::steady_clock::duration latency)
+{
+    auto micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    if (micros < 2)
+    {
+        return 0;
+    }
+    size_t index = std::bit_width(static_cast<uint64_t>(micros)) - 1;
+    if (index >= buckets)
+    {
+        return buckets - 1;
+    }
+    return index;
+}
+
+std::vector<ScanStatistics::Row> ScanStatistics::rows() const
+{
+    std::vector<Row> ret;
+    ret.reserve(stats.size());
+    for (const auto& [key, entry] : stats)
+    {
+        const auto& [service, interface, method] = key;
+        ret.emplace_back(service, interface, method, entry.calls, entry.errors,
+                         entry.retries,
+                         std::vector<uint64_t>(entry.histogram.begin(),
+                                               entry.histogram.end()));
+    }
+    return ret;
+}
+
+ScanStatistics::PublishRow ScanStatistics::publishRow() const
+{
+    return {publish.slices, publish.records, publish.longestMicroseconds,
+            std::vector<uint64_t>(publish.histogram.begin(),
+                                  publish.histogram.end())};
+}
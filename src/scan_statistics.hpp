@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/// \brief Latency accounting for the D-Bus calls made while scanning.
+///
+/// Calls are accounted per (service, interface, method).  Latencies are kept
+/// in a log2 histogram of microseconds: bucket 0 counts calls that completed
+/// in under 2us, bucket n those that took [2^n, 2^(n+1))us, and the last
+/// bucket everything slower.
+class ScanStatistics
+{
+  public:
+    static constexpr size_t buckets = 24;
+
+    using Key = std::tuple<std::string, std::string, std::string>;
+
+    struct Entry
+    {
+        std::array<uint64_t, buckets> histogram{};
+        uint64_t calls = 0;
+        uint64_t errors = 0;
+        uint64_t retries = 0;
+    };
+
+    /// D-Bus representation, (service, interface, method, calls, errors,
+    /// retries, histogram).
+    using Row = std::tuple<std::string, std::string, std::string, uint64_t,
+                           uint64_t, uint64_t, std::vector<uint64_t>>;
+
+    /// Time the io loop was held by publishing, one histogram entry per slice.
+    struct PublishEntry
+    {
+        std::array<uint64_t, buckets> histogram{};
+        uint64_t slices = 0;
+        uint64_t records = 0;
+        uint64_t longestMicroseconds = 0;
+    };
+
+    /// D-Bus representation, (slices, records, longest slice in
+    /// microseconds, histogram).
+    using PublishRow =
+        std::tuple<uint64_t, uint64_t, uint64_t, std::vector<uint64_t>>;
+
+    /// \brief Account a completed call.
+    /// \param service the destination the call was sent to.
+    /// \param interface the interface the call was made on, or for GetAll the
+    /// interface whose properties were requested.
+    /// \param method the method called.
+    /// \param latency the time from sending the call to its reply.
+    /// \param error true if the call returned an error.
+    void record(const std::string& service, const std::string& interface,
+                const std::string& method,
+                std::chrono::steady_clock::duration latency, bool error);
+
+    /// \brief Account a call being reissued after an error.
+    void retry(const std::string& service, const std::string& interface,
+               const std::string& method);
+
+    /// \brief Account a slice of publishing run on the io loop.
+    /// \param held the time the slice ran for.
+    /// \param records the number of records it published.
+    void recordPublishSlice(std::chrono::steady_clock::duration held,
+                            size_t records);
+
+    static size_t bucket(std::chrono::steady_clock::duration latency);
+
+    const std::map<Key, Entry>& entries() const
+    {
+        return stats;
+    }
+
+    std::vector<Row> rows() const;
+
+    const PublishEntry& publishEntry() const
+    {
+        return publish;
+    }
+
+    PublishRow publishRow() const;
+
+  private:
+    std::map<Key, Entry> stats;
+    PublishEntry publish;
+};
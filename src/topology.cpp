@@ -1,5 +1,6 @@
 #include "topology.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 void Topology::addBoard(const std::string& path, const std::string& boardType,
@@ -27,18 +28,26 @@ void Topology::addBoard(const std::string& path, const std::string& boardType,
         }
         PortType connectsTo = findConnectsTo->get<std::string>();
 
+        Board& board = getBoard(path, boardName);
         downstreamPorts[connectsTo].emplace_back(path);
-        boardTypes[path] = boardType;
+        board.downstream.emplace_back(connectsTo);
+        board.type = boardType;
         auto findPoweredBy = exposesItem.find("PowerPort");
         if (findPoweredBy != exposesItem.end())
         {
-            powerPaths.insert(path);
+            board.powered = true;
         }
+        changed.insert(path);
+        touchConnected(connectsTo, false);
     }
     else if (exposesType.ends_with("Port"))
     {
+        Board& board = getBoard(path, boardName);
         upstreamPorts[exposesType].emplace_back(path);
-        boardTypes[path] = boardType;
+        board.upstream.emplace_back(exposesType);
+        board.type = boardType;
+        changed.insert(path);
+        touchConnected(exposesType, true);
     }
 }
 
@@ -47,35 +56,34 @@ std::unordered_map<std::string, std::vector<Association>>
 {
     std::unordered_map<std::string, std::vector<Association>> result;
 
-    // look at each upstream port type
-    for (const auto& upstreamPortPair : upstreamPorts)
+    // only the ports of the boards we care about have to be looked at
+    for (const auto& [downstream, _] : boards)
     {
-        auto downstreamMatch = downstreamPorts.find(upstreamPortPair.first);
-
-        if (downstreamMatch == downstreamPorts.end())
+        auto findBoard = boardsByPath.find(downstream);
+        if (findBoard == boardsByPath.end())
         {
-            // no match
             continue;
         }
-
-        for (const Path& upstream : upstreamPortPair.second)
+        for (const PortType& port : findBoard->second.downstream)
         {
-            if (boardTypes[upstream] == "Chassis" ||
-                boardTypes[upstream] == "Board")
+            auto upstreamMatch = upstreamPorts.find(port);
+            if (upstreamMatch == upstreamPorts.end())
             {
-                for (const Path& downstream : downstreamMatch->second)
+                // no match
+                continue;
+            }
+            for (const Path& upstream : upstreamMatch->second)
+            {
+                if (!isContainer(upstream))
                 {
-                    // The downstream path must be one we care about.
-                    if (boards.find(downstream) != boards.end())
-                    {
-                        result[downstream].emplace_back("contained_by",
-                                                        "containing", upstream);
-                        if (powerPaths.find(downstream) != powerPaths.end())
-                        {
-                            result[upstream].emplace_back(
-                                "powered_by", "powering", downstream);
-                        }
-                    }
+                    continue;
+                }
+                result[downstream].emplace_back("contained_by", "containing",
+                                                upstream);
+                if (findBoard->second.powered)
+                {
+                    result[upstream].emplace_back("powered_by", "powering",
+                                                  downstream);
                 }
             }
         }
@@ -84,11 +92,31 @@ std::unordered_map<std::string, std::vector<Association>>
     return result;
 }
 
+static void removePath(
+    std::unordered_map<std::string, std::vector<std::string>>& ports,
+    const std::string& port, const std::string& path)
+{
+    auto findPort = ports.find(port);
+    if (findPort == ports.end())
+    {
+        return;
+    }
+    auto pathIt = std::find(findPort->second.begin(), findPort->second.end(),
+                            path);
+    if (pathIt != findPort->second.end())
+    {
+        findPort->second.erase(pathIt);
+    }
+    if (findPort->second.empty())
+    {
+        ports.erase(findPort);
+    }
+}
+
 void Topology::remove(const std::string& boardName)
 {
     // Remove the board from boardNames, and then using the path
-    // found in boardNames remove it from upstreamPorts and
-    // downstreamPorts.
+    // found in boardNames remove its ports.
     auto boardFind = boardNames.find(boardName);
     if (boardFind == boardNames.end())
     {
@@ -99,41 +127,138 @@ void Topology::remove(const std::string& boardName)
 
     boardNames.erase(boardFind);
 
-    for (auto it = upstreamPorts.begin(); it != upstreamPorts.end();)
+    auto findBoard = boardsByPath.find(boardPath);
+    if (findBoard == boardsByPath.end())
     {
-        auto pathIt = std::find(it->second.begin(), it->second.end(),
-                                boardPath);
-        if (pathIt != it->second.end())
-        {
-            it->second.erase(pathIt);
-        }
+        return;
+    }
+    for (const PortType& port : findBoard->second.upstream)
+    {
+        removePath(upstreamPorts, port, boardPath);
+        touchConnected(port, true);
+    }
+    for (const PortType& port : findBoard->second.downstream)
+    {
+        removePath(downstreamPorts, port, boardPath);
+        touchConnected(port, false);
+    }
+    boardsByPath.erase(findBoard);
+    changed.erase(boardPath);
+}
 
-        if (it->second.empty())
+std::unordered_map<std::string, std::vector<Association>>
+    Topology::takeChanges()
+{
+    std::unordered_map<std::string, std::vector<Association>> result;
+    for (const Path& path : changed)
+    {
+        auto findBoard = boardsByPath.find(path);
+        if (findBoard == boardsByPath.end())
         {
-            it = upstreamPorts.erase(it);
+            continue;
         }
-        else
+        std::vector<Association> associations =
+            findAssociations(findBoard->second);
+        if (associations != findBoard->second.associations)
         {
-            ++it;
+            findBoard->second.associations = associations;
+            result.emplace(path, std::move(associations));
         }
     }
+    changed.clear();
+    return result;
+}
 
-    for (auto it = downstreamPorts.begin(); it != downstreamPorts.end();)
+const std::vector<Association>*
+    Topology::getAssociations(const std::string& path) const
+{
+    auto findBoard = boardsByPath.find(path);
+    if (findBoard == boardsByPath.end())
     {
-        auto pathIt = std::find(it->second.begin(), it->second.end(),
-                                boardPath);
-        if (pathIt != it->second.end())
+        return nullptr;
+    }
+    return &findBoard->second.associations;
+}
+
+const std::string* Topology::getBoardName(const std::string& path) const
+{
+    auto findBoard = boardsByPath.find(path);
+    if (findBoard == boardsByPath.end())
+    {
+        return nullptr;
+    }
+    return &findBoard->second.name;
+}
+
+Topology::Board& Topology::getBoard(const Path& path,
+                                   const BoardName& boardName)
+{
+    auto [findBoard, inserted] = boardsByPath.try_emplace(path);
+    if (inserted)
+    {
+        findBoard->second.name = boardName;
+    }
+    return findBoard->second;
+}
+
+bool Topology::isContainer(const Path& path) const
+{
+    auto findBoard = boardsByPath.find(path);
+    return findBoard != boardsByPath.end() &&
+           (findBoard->second.type == "Chassis" ||
+            findBoard->second.type == "Board");
+}
+
+// Works out all the associations of a board from the ports indexed by type,
+// sorted so that they can be compared with what was published before.
+std::vector<Association> Topology::findAssociations(const Board& board) const
+{
+    std::vector<Association> result;
+    for (const PortType& port : board.downstream)
+    {
+        auto upstreamMatch = upstreamPorts.find(port);
+        if (upstreamMatch == upstreamPorts.end())
         {
-            it->second.erase(pathIt);
+            continue;
         }
-
-        if (it->second.empty())
+        for (const Path& upstream : upstreamMatch->second)
         {
-            it = downstreamPorts.erase(it);
+            if (isContainer(upstream))
+            {
+                result.emplace_back("contained_by", "containing", upstream);
+            }
         }
-        else
+    }
+    if (board.type == "Chassis" || board.type == "Board")
+    {
+        for (const PortType& port : board.upstream)
         {
-            ++it;
+            auto downstreamMatch = downstreamPorts.find(port);
+            if (downstreamMatch == downstreamPorts.end())
+            {
+                continue;
+            }
+            for (const Path& downstream : downstreamMatch->second)
+            {
+                if (boardsByPath.at(downstream).powered)
+                {
+                    result.emplace_back("powered_by", "powering", downstream);
+                }
+            }
         }
     }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void Topology::touchConnected(const PortType& port, bool upstream)
+{
+    // an upstream port contains the boards whose downstream ports connect to
+    // it, and is powered by them
+    const auto& connected = upstream ? downstreamPorts : upstreamPorts;
+    auto findPort = connected.find(port);
+    if (findPort != connected.end())
+    {
+        changed.insert(findPort->second.begin(), findPort->second.end());
+    }
 }
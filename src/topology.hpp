@@ -19,15 +19,49 @@ class Topology
         getAssocs(const std::map<std::string, std::string>& boards);
     void remove(const std::string& boardName);
 
+    /// \brief Take the associations of the boards whose associations changed
+    /// since the last call, from adding or removing them or a board they
+    /// connect to.
+    /// \return the full list of each such board's associations by path, which
+    /// is empty for a board left without any.
+    std::unordered_map<std::string, std::vector<Association>> takeChanges();
+
+    /// \return the associations of the board at path as of the last
+    /// takeChanges, or nullptr if there is no such board.
+    const std::vector<Association>*
+        getAssociations(const std::string& path) const;
+
+    /// \return the name of the board at path, or nullptr if there is no
+    /// such board.
+    const std::string* getBoardName(const std::string& path) const;
+
   private:
     using Path = std::string;
     using BoardType = std::string;
     using BoardName = std::string;
     using PortType = std::string;
 
+    struct Board
+    {
+        BoardName name;
+        BoardType type;
+        // the types of the ports the board exposes, and for downstream ports
+        // the types they connect to
+        std::vector<PortType> upstream;
+        std::vector<PortType> downstream;
+        bool powered = false;
+        std::vector<Association> associations;
+    };
+
+    Board& getBoard(const Path& path, const BoardName& boardName);
+    bool isContainer(const Path& path) const;
+    std::vector<Association> findAssociations(const Board& board) const;
+    // marks the boards whose associations depend on the port
+    void touchConnected(const PortType& port, bool upstream);
+
     std::unordered_map<PortType, std::vector<Path>> upstreamPorts;
     std::unordered_map<PortType, std::vector<Path>> downstreamPorts;
-    std::set<Path> powerPaths;
-    std::unordered_map<Path, BoardType> boardTypes;
+    std::unordered_map<Path, Board> boardsByPath;
     std::unordered_map<BoardName, Path> boardNames;
+    std::set<Path> changed;
 };
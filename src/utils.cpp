@@ -20,6 +20,7 @@
 #include "expression.hpp"
 #include "variant_visitors.hpp"
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/find.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -33,11 +34,16 @@
 #include <valijson/schema_parser.hpp>
 #include <valijson/validator.hpp>
 
+#include <array>
+#include <bit>
+#include <cctype>
 #include <charconv>
 #include <filesystem>
 #include <fstream>
 #include <map>
 #include <regex>
+#include <shared_mutex>
+#include <unordered_map>
 
 constexpr const char* templateChar = "$";
 
@@ -184,47 +190,58 @@ void setupPowerMatch(const std::shared_ptr<sdbusplus::asio::connection>& conn)
         power::interface, power::property);
 }
 
-// Replaces the template character like the other version of this function,
-// but checks all properties on all interfaces provided to do the substitution
-// with.
-std::optional<std::string>
-    templateCharReplace(nlohmann::json::iterator& keyPair,
-                        const DBusObject& object, const size_t index,
-                        const std::optional<std::string>& replaceStr)
+// Strings that read as a whole decimal or 0x prefixed hex number are stored as
+// numbers.
+static void convertNumericString(nlohmann::json& value)
 {
-    for (const auto& [_, interface] : object)
+    const std::string* strPtr = value.get_ptr<const std::string*>();
+    if (strPtr == nullptr)
     {
-        auto ret = templateCharReplace(keyPair, interface, index, replaceStr);
-        if (ret)
+        return;
+    }
+
+    std::string_view strView = *strPtr;
+    int base = 10;
+    if (boost::starts_with(strView, "0x"))
+    {
+        strView.remove_prefix(2);
+        base = 16;
+    }
+
+    uint64_t temp = 0;
+    const char* strDataEndPtr = strView.data() + strView.size();
+    const std::from_chars_result res =
+        std::from_chars(strView.data(), strDataEndPtr, temp, base);
+    if (res.ec == std::errc{} && res.ptr == strDataEndPtr)
+    {
+        value = temp;
+    }
+}
+
+// Template arithmetic only applies to numeric properties.
+static std::optional<int64_t> templateNumber(const DBusValueVariant& value)
+{
+    return std::visit([](auto&& val) -> std::optional<int64_t> {
+        if constexpr (std::is_arithmetic_v<std::decay_t<decltype(val)>>)
         {
-            return ret;
+            return static_cast<int64_t>(val);
         }
-    }
-    return std::nullopt;
+        return std::nullopt;
+    }, value);
 }
 
 // finds the template character (currently set to $) and replaces the value with
 // the field found in a dbus object i.e. $ADDRESS would get populated with the
-// ADDRESS field from a object on dbus
-std::optional<std::string>
-    templateCharReplace(nlohmann::json::iterator& keyPair,
-                        const DBusInterface& interface, const size_t index,
-                        const std::optional<std::string>& replaceStr)
+// ADDRESS field from a object on dbus.  This is the general form of the
+// substitution, used for the templates a TemplatePlan can't describe.
+static std::optional<std::string>
+    genericTemplateReplace(nlohmann::json& value,
+                           const DBusInterface& interface, const size_t index,
+                           const std::optional<std::string>& replaceStr)
 {
     std::optional<std::string> ret = std::nullopt;
 
-    if (keyPair.value().type() == nlohmann::json::value_t::object ||
-        keyPair.value().type() == nlohmann::json::value_t::array)
-    {
-        for (auto nextLayer = keyPair.value().begin();
-             nextLayer != keyPair.value().end(); nextLayer++)
-        {
-            templateCharReplace(nextLayer, interface, index, replaceStr);
-        }
-        return ret;
-    }
-
-    std::string* strPtr = keyPair.value().get_ptr<std::string*>();
+    std::string* strPtr = value.get_ptr<std::string*>();
     if (strPtr == nullptr)
     {
         return ret;
@@ -252,7 +269,7 @@ std::optional<std::string>
         // check for additional operations
         if ((start == 0U) && find.end() == strPtr->end())
         {
-            std::visit([&](auto&& val) { keyPair.value() = val; }, propValue);
+            std::visit([&](auto&& val) { value = val; }, propValue);
             return ret;
         }
 
@@ -291,64 +308,362 @@ std::optional<std::string>
             continue;
         }
 
-        // we assume that the replacement is a number, because we can
-        // only do math on numbers.. we might concatenate strings in the
-        // future, but thats later
-        int number = std::visit(VariantToIntVisitor(), propValue);
-        auto exprBegin = split.begin();
-        auto exprEnd = split.end();
-
-        number = expression::evaluate(number, exprBegin, exprEnd);
+        // evaluated as by a TemplatePlan, $index was already substituted
+        std::vector<std::string>::const_iterator exprEnd = split.end();
+        std::optional<expression::Program> program =
+            expression::Program::compile(split.begin(), exprEnd,
+                                         std::string(templateChar) + "index");
+        std::optional<int64_t> number = templateNumber(propValue);
+        if (program && number)
+        {
+            number = program->run(*number, static_cast<int64_t>(index));
+        }
+        if (!program || !number)
+        {
+            std::cerr << "Unable to evaluate template " << *strPtr << "\n";
+            continue;
+        }
 
         std::string replaced(find.begin(), find.end());
-        while (exprBegin != exprEnd)
+        for (auto word = split.cbegin(); word != exprEnd; word++)
         {
-            replaced.append(" ").append(*exprBegin++);
+            replaced.append(" ").append(*word);
         }
         ret = replaced;
 
-        std::string result = prefix + std::to_string(number);
-        while (exprEnd != split.end())
+        std::string result = prefix + std::to_string(*number);
+        for (; exprEnd != split.cend(); exprEnd++)
         {
-            result.append(" ").append(*exprEnd++);
+            result.append(" ").append(*exprEnd);
         }
-        keyPair.value() = result;
+        value = result;
 
         // We probably just invalidated the pointer abovei,
         // reset and continue to handle multiple templates
-        strPtr = keyPair.value().get_ptr<std::string*>();
+        strPtr = value.get_ptr<std::string*>();
         if (strPtr == nullptr)
         {
             break;
         }
     }
 
-    strPtr = keyPair.value().get_ptr<std::string*>();
+    convertNumericString(value);
+    return ret;
+}
+
+// Checks all properties on all interfaces provided to do the substitution
+// with.
+static std::optional<std::string>
+    genericTemplateReplace(nlohmann::json& value, const DBusObject& object,
+                           const size_t index,
+                           const std::optional<std::string>& replaceStr)
+{
+    for (const auto& [_, interface] : object)
+    {
+        auto ret = genericTemplateReplace(value, interface, index, replaceStr);
+        if (ret)
+        {
+            return ret;
+        }
+    }
+    return std::nullopt;
+}
+
+static bool isTemplateMathChar(char c)
+{
+    return c == '+' || c == '-' || c == '%' || c == '*' || c == '/';
+}
+
+TemplatePlan TemplatePlan::compile(std::string_view value)
+{
+    TemplatePlan plan;
+    constexpr std::string_view indexRef = "index";
+    std::string literal;
+
+    auto flush = [&plan, &literal]() {
+        if (!literal.empty())
+        {
+            plan.tokens.push_back({Kind::literal, std::move(literal), {}, {}});
+            literal.clear();
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < value.size())
+    {
+        if (value[pos] != *templateChar)
+        {
+            literal += value[pos++];
+            continue;
+        }
+        std::string_view rest = value.substr(pos + 1);
+        if (rest.starts_with(indexRef))
+        {
+            flush();
+            plan.tokens.push_back({Kind::index, {}, {}, {}});
+            pos += 1 + indexRef.size();
+            continue;
+        }
+
+        size_t end = pos + 1;
+        while (end < value.size() &&
+               ((std::isalnum(static_cast<unsigned char>(value[end])) != 0) ||
+                value[end] == '_'))
+        {
+            end++;
+        }
+        if (end == pos + 1)
+        {
+            literal += value[pos++];
+            continue;
+        }
+        flush();
+        Token property{Kind::property,
+                       std::string(value.substr(pos + 1, end - pos - 1)),
+                       {},
+                       {}};
+
+        // arithmetic is applied when an operator follows the reference after
+        // a single separator
+        size_t next = end + 1;
+        if (next > value.size() ||
+            (next < value.size() && !isTemplateMathChar(value[next])))
+        {
+            plan.tokens.push_back(std::move(property));
+            pos = end;
+            continue;
+        }
+        if (next == value.size() || value[end] != ' ')
+        {
+            plan.generic = true;
+            return plan;
+        }
+
+        std::vector<std::string> split;
+        boost::split(split, value.substr(next), boost::is_any_of(" "));
+        if (split.size() < 2)
+        {
+            plan.generic = true;
+            return plan;
+        }
+
+        // Operands are integers or $index, anything else is left to the
+        // general substitution.
+        std::vector<std::string>::const_iterator exprEnd = split.end();
+        std::optional<expression::Program> program =
+            expression::Program::compile(split.begin(), exprEnd,
+                                         std::string(templateChar) + "index");
+        size_t consumed = exprEnd - split.cbegin();
+        if (!program || consumed == 0)
+        {
+            plan.generic = true;
+            return plan;
+        }
+
+        pos = next;
+        for (size_t i = 0; i < consumed; i++)
+        {
+            pos += split[i].size() + 1;
+        }
+        // the separator after the expression is kept as a literal
+        pos--;
+        property.expression.assign(split.begin(), split.begin() + consumed);
+        property.program = std::move(*program);
+        plan.tokens.push_back(std::move(property));
+    }
+    flush();
+
+    plan.wholeValue = plan.tokens.size() == 1 &&
+                      plan.tokens[0].kind == Kind::property &&
+                      plan.tokens[0].expression.empty();
+    return plan;
+}
+
+// Template strings repeat across every device found by a configuration, so
+// their plans are kept for the life of the process.  Devices may be expanded
+// in parallel, and plans are never removed, so references stay valid once the
+// lock is dropped.
+static const TemplatePlan& templatePlan(const std::string& value)
+{
+    // NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+    static std::unordered_map<std::string, TemplatePlan> plans;
+    static std::shared_mutex plansMutex;
+    // NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+    {
+        std::shared_lock lock(plansMutex);
+        auto find = plans.find(value);
+        if (find != plans.end())
+        {
+            return find->second;
+        }
+    }
+
+    TemplatePlan plan = TemplatePlan::compile(value);
+    std::unique_lock lock(plansMutex);
+    return plans.try_emplace(value, std::move(plan)).first->second;
+}
+
+static const DBusValueVariant* findTemplateProperty(
+    const DBusInterface& interface, const std::string& name)
+{
+    for (const auto& [propName, propValue] : interface)
+    {
+        if (boost::iequals(propName, name))
+        {
+            return &propValue;
+        }
+    }
+    return nullptr;
+}
+
+static const DBusValueVariant* findTemplateProperty(const DBusObject& object,
+                                                    const std::string& name)
+{
+    for (const auto& [_, interface] : object)
+    {
+        const DBusValueVariant* found = findTemplateProperty(interface, name);
+        if (found != nullptr)
+        {
+            return found;
+        }
+    }
+    return nullptr;
+}
+
+template <typename PropertySource>
+static std::optional<std::string>
+    templateReplace(nlohmann::json& value, const PropertySource& source,
+                    const size_t index,
+                    const std::optional<std::string>& replaceStr)
+{
+    if (value.type() == nlohmann::json::value_t::object ||
+        value.type() == nlohmann::json::value_t::array)
+    {
+        for (auto& nextLayer : value)
+        {
+            templateReplace(nextLayer, source, index, replaceStr);
+        }
+        return std::nullopt;
+    }
+
+    const std::string* strPtr = value.get_ptr<const std::string*>();
     if (strPtr == nullptr)
     {
-        return ret;
+        return std::nullopt;
+    }
+    if (strPtr->find(*templateChar) == std::string::npos)
+    {
+        convertNumericString(value);
+        return std::nullopt;
     }
 
-    std::string_view strView = *strPtr;
-    int base = 10;
-    if (boost::starts_with(strView, "0x"))
+    const TemplatePlan& plan = templatePlan(*strPtr);
+    if (plan.generic || replaceStr)
     {
-        strView.remove_prefix(2);
-        base = 16;
+        return genericTemplateReplace(value, source, index, replaceStr);
     }
 
-    uint64_t temp = 0;
-    const char* strDataEndPtr = strView.data() + strView.size();
-    const std::from_chars_result res =
-        std::from_chars(strView.data(), strDataEndPtr, temp, base);
-    if (res.ec == std::errc{} && res.ptr == strDataEndPtr)
+    // Every reference has to name a property exactly, the general form
+    // handles the rest.
+    std::vector<const DBusValueVariant*> properties;
+    for (const TemplatePlan::Token& token : plan.tokens)
+    {
+        if (token.kind != TemplatePlan::Kind::property)
+        {
+            continue;
+        }
+        const DBusValueVariant* found = findTemplateProperty(source,
+                                                             token.text);
+        if (found == nullptr)
+        {
+            return genericTemplateReplace(value, source, index, replaceStr);
+        }
+        properties.push_back(found);
+    }
+
+    if (plan.wholeValue)
     {
-        keyPair.value() = temp;
+        std::visit([&](auto&& val) { value = val; }, *properties.front());
+        return std::nullopt;
     }
 
+    std::optional<std::string> ret = std::nullopt;
+    std::string result;
+    auto property = properties.begin();
+    for (const TemplatePlan::Token& token : plan.tokens)
+    {
+        switch (token.kind)
+        {
+            case TemplatePlan::Kind::literal:
+            {
+                result += token.text;
+                break;
+            }
+            case TemplatePlan::Kind::index:
+            {
+                result += std::to_string(index);
+                break;
+            }
+            case TemplatePlan::Kind::property:
+            {
+                const DBusValueVariant& propValue = **property++;
+                if (token.expression.empty())
+                {
+                    result += std::visit(VariantToStringVisitor(), propValue);
+                    break;
+                }
+
+                std::string replaced = templateChar + token.text;
+                for (const std::string& item : token.expression)
+                {
+                    replaced.append(" ").append(
+                        boost::replace_all_copy(item,
+                                                std::string(templateChar) +
+                                                    "index",
+                                                std::to_string(index)));
+                }
+                std::optional<int64_t> number = templateNumber(propValue);
+                if (number)
+                {
+                    number = token.program.run(*number,
+                                               static_cast<int64_t>(index));
+                }
+                if (!number)
+                {
+                    std::cerr << "Unable to evaluate template " << replaced
+                              << "\n";
+                    result += replaced;
+                    break;
+                }
+                result += std::to_string(*number);
+                ret = std::move(replaced);
+                break;
+            }
+        }
+    }
+    value = std::move(result);
+
+    convertNumericString(value);
     return ret;
 }
 
+std::optional<std::string>
+    templateCharReplace(nlohmann::json::iterator& keyPair,
+                        const DBusObject& object, const size_t index,
+                        const std::optional<std::string>& replaceStr)
+{
+    return templateReplace(keyPair.value(), object, index, replaceStr);
+}
+
+std::optional<std::string>
+    templateCharReplace(nlohmann::json::iterator& keyPair,
+                        const DBusInterface& interface, const size_t index,
+                        const std::optional<std::string>& replaceStr)
+{
+    return templateReplace(keyPair.value(), interface, index, replaceStr);
+}
+
 /// \brief JSON/DBus matching Callable for std::variant (visitor)
 ///
 /// Default match JSON/DBus match implementation
@@ -417,3 +732,229 @@ bool matchProbe(const nlohmann::json& probe, const DBusValueVariant& dbusValue)
 {
     return std::visit(MatchProbeForwarder(probe), dbusValue);
 }
+
+void PropertyProjection::addTemplateReferences(const nlohmann::json& value)
+{
+    if (value.is_object() || value.is_array())
+    {
+        for (const nlohmann::json& item : value)
+        {
+            addTemplateReferences(item);
+        }
+        return;
+    }
+
+    const std::string* str = value.get_ptr<const std::string*>();
+    if (str == nullptr)
+    {
+        return;
+    }
+
+    for (size_t start = str->find(templateChar); start != std::string::npos;
+         start = str->find(templateChar, start))
+    {
+        start++;
+        size_t end = start;
+        while (end < str->size() &&
+               (std::isalnum(static_cast<unsigned char>((*str)[end])) != 0 ||
+                (*str)[end] == '_'))
+        {
+            end++;
+        }
+        if (end == start)
+        {
+            continue;
+        }
+        std::string reference =
+            boost::algorithm::to_lower_copy(str->substr(start, end - start));
+        if (reference != "index")
+        {
+            templateReferences.emplace(std::move(reference));
+        }
+        start = end;
+    }
+}
+
+bool PropertyProjection::wantsProperty(const std::string& interface,
+                                       std::string_view property) const
+{
+    if (probedInterfaces.contains(interface))
+    {
+        return true;
+    }
+
+    std::string name = boost::algorithm::to_lower_copy(std::string(property));
+    // any reference that starts with name sorts directly after it
+    auto find = templateReferences.lower_bound(name);
+    return find != templateReferences.end() && find->starts_with(name);
+}
+
+bool PropertyProjection::wantsInterface(const std::string& interface) const
+{
+    return !templateReferences.empty() || probedInterfaces.contains(interface);
+}
+
+namespace
+{
+// 64 bit FNV-1a, fed a field at a time.  Multi byte values are fed little
+// endian so the result doesn't depend on the host.
+class RecordNameHash
+{
+  public:
+    void add(const uint8_t* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= prime;
+        }
+    }
+
+    void add(uint64_t value)
+    {
+        for (size_t i = 0; i < sizeof(value); i++)
+        {
+            uint8_t byte = static_cast<uint8_t>(value >> (i * 8));
+            add(&byte, 1);
+        }
+    }
+
+    void add(std::string_view value)
+    {
+        add(static_cast<uint64_t>(value.size()));
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        add(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    void addTag(char tag)
+    {
+        uint8_t byte = static_cast<uint8_t>(tag);
+        add(&byte, 1);
+    }
+
+    uint64_t value() const
+    {
+        return hash;
+    }
+
+  private:
+    static constexpr uint64_t offsetBasis = 0xcbf29ce484222325;
+    static constexpr uint64_t prime = 0x100000001b3;
+    uint64_t hash = offsetBasis;
+};
+} // namespace
+
+namespace
+{
+constexpr std::array<bool, 256> dbusNameCharacters(bool allowDot)
+{
+    std::array<bool, 256> legal{};
+    for (size_t c = 0; c < legal.size(); c++)
+    {
+        legal[c] = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+                   (c >= '0' && c <= '9') || c == '_' || (allowDot && c == '.');
+    }
+    return legal;
+}
+
+constexpr std::array<bool, 256> dbusMemberCharacters =
+    dbusNameCharacters(false);
+constexpr std::array<bool, 256> dbusPathCharacters = dbusNameCharacters(true);
+} // namespace
+
+std::string sanitizeDbusName(std::string_view name, bool allowDot)
+{
+    const std::array<bool, 256>& legal = allowDot ? dbusPathCharacters
+                                                  : dbusMemberCharacters;
+    std::string sanitized(name);
+    for (char& c : sanitized)
+    {
+        if (!legal[static_cast<unsigned char>(c)])
+        {
+            c = '_';
+        }
+    }
+    return sanitized;
+}
+
+std::string getRecordName(const DBusInterface& probe,
+                          const std::string& probeName)
+{
+    if (probe.empty())
+    {
+        return probeName;
+    }
+
+    RecordNameHash hash;
+    hash.add(&recordNameVersion, 1);
+    hash.add(probeName);
+    // the flat_map keeps the properties in alphabetical order
+    for (const auto& [name, value] : probe)
+    {
+        hash.add(name);
+        std::visit(
+            [&hash](auto&& val) {
+            using T = std::decay_t<decltype(val)>;
+            if constexpr (std::is_same_v<T, std::string>)
+            {
+                hash.addTag('s');
+                hash.add(val);
+            }
+            else if constexpr (std::is_same_v<T, std::vector<uint8_t>>)
+            {
+                hash.addTag('a');
+                hash.add(static_cast<uint64_t>(val.size()));
+                hash.add(val.data(), val.size());
+            }
+            else if constexpr (std::is_same_v<T, bool>)
+            {
+                hash.addTag('b');
+                hash.add(static_cast<uint64_t>(val));
+            }
+            else if constexpr (std::is_same_v<T, double>)
+            {
+                hash.addTag('d');
+                hash.add(std::bit_cast<uint64_t>(val));
+            }
+            else if constexpr (std::is_signed_v<T>)
+            {
+                hash.addTag('i');
+                hash.add(static_cast<uint64_t>(static_cast<int64_t>(val)));
+            }
+            else
+            {
+                hash.addTag('u');
+                hash.add(static_cast<uint64_t>(val));
+            }
+        },
+            value);
+    }
+
+    std::array<char, 16> digits{};
+    std::to_chars_result res = std::to_chars(
+        digits.data(), digits.data() + digits.size(), hash.value(), 16);
+    std::string name = "v" + std::to_string(recordNameVersion) + "-";
+    name.append(16 - (res.ptr - digits.data()), '0');
+    name.append(digits.data(), res.ptr);
+    return name;
+}
+
+std::string getLegacyRecordName(const DBusInterface& probe,
+                                const std::string& probeName)
+{
+    if (probe.empty())
+    {
+        return probeName;
+    }
+
+    // use an array so alphabetical order from the flat_map is maintained
+    auto device = nlohmann::json::array();
+    for (const auto& devPair : probe)
+    {
+        device.push_back(devPair.first);
+        std::visit([&device](auto&& v) { device.push_back(v); },
+                   devPair.second);
+    }
+
+    return std::to_string(std::hash<std::string>{}(probeName + device.dump()));
+}
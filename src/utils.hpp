@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "expression.hpp"
+
 #include <boost/container/flat_map.hpp>
 #include <nlohmann/json.hpp>
 #include <sdbusplus/asio/connection.hpp>
@@ -25,6 +27,8 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <set>
+#include <string_view>
 
 constexpr const char* configurationOutDir = "/var/configuration/";
 constexpr const char* versionHashFile = "/var/configuration/version";
@@ -131,6 +135,42 @@ inline bool fwVersionIsSame()
     return false;
 }
 
+/// \brief A configuration string split at its template references, so that
+/// expanding it for each found device doesn't have to search it again.
+struct TemplatePlan
+{
+    enum class Kind
+    {
+        literal,
+        property,
+        index,
+    };
+
+    struct Token
+    {
+        Kind kind;
+        /// The literal text, or the property name as written.
+        std::string text;
+        /// For a property, the arithmetic applied to it as operator and
+        /// operand words.
+        std::vector<std::string> expression;
+        /// The compiled form of expression.
+        expression::Program program;
+    };
+
+    /// \brief Split value into tokens.
+    /// \param value the configuration string.
+    /// \return the plan, marked generic if value uses a form of template the
+    /// tokens can't express.
+    static TemplatePlan compile(std::string_view value);
+
+    std::vector<Token> tokens;
+    /// The value is a single property reference and takes on its type.
+    bool wholeValue = false;
+    /// The value has to go through the general substitution.
+    bool generic = false;
+};
+
 std::optional<std::string> templateCharReplace(
     nlohmann::json::iterator& keyPair, const DBusObject& object, size_t index,
     const std::optional<std::string>& replaceStr = std::nullopt);
@@ -161,3 +201,59 @@ inline bool deviceHasLogging(const nlohmann::json& json)
 /// \param dbusValue the property value being matched to a probe.
 /// \return true if the dbusValue matched the probe otherwise false.
 bool matchProbe(const nlohmann::json& probe, const DBusValueVariant& dbusValue);
+
+/// \brief The D-Bus properties that a set of configurations can make use of.
+///
+/// Used to skip decoding properties that neither a probe nor a template will
+/// ever look at.
+struct PropertyProjection
+{
+    /// \brief Add the $Property template references found in value.
+    /// \param value the configuration, or any part of it, to search.
+    void addTemplateReferences(const nlohmann::json& value);
+
+    /// \param interface the interface the property is on.
+    /// \param property the name of the property.
+    /// \return true if the property has to be decoded.
+    bool wantsProperty(const std::string& interface,
+                       std::string_view property) const;
+
+    /// \param interface the interface to check.
+    /// \return true if any property of the interface has to be decoded.
+    bool wantsInterface(const std::string& interface) const;
+
+    /// Interfaces named in probe statements.  These are always decoded in
+    /// full, as the record names of found devices are derived from them.
+    std::set<std::string> probedInterfaces;
+
+    /// Lower case identifiers following the template character.  As template
+    /// substitution is a case insensitive prefix match, so is the lookup.
+    std::set<std::string, std::less<>> templateReferences;
+};
+
+/// \brief Version of the record name encoding.  Bump it whenever the encoding
+/// hashed by getRecordName changes, so old and new names can't be confused.
+constexpr uint8_t recordNameVersion = 1;
+
+/// \brief Replace every character that isn't allowed in a D-Bus object path
+/// element or member name with '_'.
+/// \param name the string to sanitize.
+/// \param allowDot also allow '.', as the type part of interface names does.
+/// \return the sanitized string.
+std::string sanitizeDbusName(std::string_view name, bool allowDot = false);
+
+/// \brief Name the record of a device found by a probe.
+///
+/// The name is a 64 bit FNV-1a hash streamed over the probe name and the
+/// properties of the interface that matched, so it is stable across builds and
+/// standard library versions.
+/// \param probe the properties of the interface that matched the probe.
+/// \param probeName the name of the configuration that was probed for.
+/// \return the record name.
+std::string getRecordName(const DBusInterface& probe,
+                          const std::string& probeName);
+
+/// \brief Name a record the way versions before recordNameVersion did, with
+/// std::hash over the properties as JSON.  Only for migrating persisted names.
+std::string getLegacyRecordName(const DBusInterface& probe,
+                                const std::string& probeName);
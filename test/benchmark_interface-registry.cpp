@@ -0,0 +1,112 @@
+#include "interface_registry.hpp"
+
+#include <boost/container/flat_map.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+// Publishes and tears down thousands of boards, through the registry and
+// through the flat_map of weak pointers it replaced.
+
+struct FakeInterface
+{};
+
+constexpr size_t boardCount = 5000;
+constexpr size_t interfacesPerBoard = 12;
+
+using Clock = std::chrono::steady_clock;
+
+static void report(const char* name, Clock::duration elapsed)
+{
+    std::cout << name << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+                     .count()
+              << "us\n";
+}
+
+int main()
+{
+    std::vector<std::string> names;
+    for (size_t board = 0; board < boardCount; board++)
+    {
+        names.emplace_back("Board " + std::to_string(board));
+    }
+    // the object server's references
+    std::vector<std::shared_ptr<FakeInterface>> owned;
+    owned.reserve(boardCount * interfacesPerBoard);
+    for (size_t i = 0; i < boardCount * interfacesPerBoard; i++)
+    {
+        owned.push_back(std::make_shared<FakeInterface>());
+    }
+
+    {
+        InterfaceRegistry<FakeInterface> registry;
+        Clock::time_point start = Clock::now();
+        for (size_t board = 0; board < boardCount; board++)
+        {
+            for (size_t i = 0; i < interfacesPerBoard; i++)
+            {
+                registry.add(names[board],
+                             owned[board * interfacesPerBoard + i]);
+            }
+        }
+        Clock::time_point added = Clock::now();
+        size_t removed = 0;
+        for (const std::string& name : names)
+        {
+            registry.removeBoard(registry.intern(name),
+                                 [&removed](const auto&) { removed++; });
+        }
+        report("registry add", added - start);
+        report("registry remove", Clock::now() - added);
+        if (removed != owned.size())
+        {
+            return 1;
+        }
+    }
+
+    {
+        boost::container::flat_map<std::string,
+                                   std::vector<std::weak_ptr<FakeInterface>>>
+            inventory;
+        Clock::time_point start = Clock::now();
+        for (size_t board = 0; board < boardCount; board++)
+        {
+            for (size_t i = 0; i < interfacesPerBoard; i++)
+            {
+                auto& ifaces = inventory[names[board]];
+                auto it = std::find_if(
+                    ifaces.begin(), ifaces.end(),
+                    [](const auto& p) { return p.expired(); });
+                if (it != ifaces.end())
+                {
+                    *it = owned[board * interfacesPerBoard + i];
+                    continue;
+                }
+                ifaces.emplace_back(owned[board * interfacesPerBoard + i]);
+            }
+        }
+        Clock::time_point added = Clock::now();
+        size_t removed = 0;
+        for (const std::string& name : names)
+        {
+            auto& ifaces = inventory[name];
+            for (auto& iface : ifaces)
+            {
+                if (iface.lock())
+                {
+                    removed++;
+                }
+            }
+            ifaces.clear();
+        }
+        report("flat_map add", added - start);
+        report("flat_map remove", Clock::now() - added);
+        if (removed != owned.size())
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "configuration_format.hpp"
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+const nlohmann::json configuration = nlohmann::json::parse(R"(
+    {
+        "Board": {
+            "Name": "Board",
+            "Exposes": [{"Name": "Fan", "Index": 3, "Scale": 0.5}, null]
+        }
+    }
+)");
+
+TEST(ConfigurationFormat, roundTrip)
+{
+    for (ConfigurationFormat format :
+         {ConfigurationFormat::json, ConfigurationFormat::cbor})
+    {
+        std::stringstream stream;
+        writeConfiguration(stream, configuration, format);
+        EXPECT_EQ(readConfiguration(stream), configuration);
+    }
+}
+
+TEST(ConfigurationFormat, cborHeader)
+{
+    std::stringstream stream;
+    writeConfiguration(stream, configuration, ConfigurationFormat::cbor);
+    std::string encoded = stream.str();
+    EXPECT_EQ(encoded.substr(0, 4), "EMCF");
+    EXPECT_LT(encoded.size(), configuration.dump().size());
+
+    // a version this build doesn't know is rejected rather than misread
+    encoded[4] = static_cast<char>(configurationFormatVersion + 1);
+    std::stringstream future(encoded);
+    EXPECT_TRUE(readConfiguration(future).is_discarded());
+
+    std::stringstream truncated(encoded.substr(0, 5));
+    EXPECT_TRUE(readConfiguration(truncated).is_discarded());
+}
@@ -0,0 +1,130 @@
+#include "configuration_persister.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+TEST(ConfigurationPersister, coalescesWrites)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                                "test_configuration_persister";
+    std::filesystem::remove_all(dir);
+    boost::asio::io_context io;
+    ConfigurationPersister persister(
+        io, dir / "system.json", 10ms,
+        ConfigurationPersister::SyncPolicy::always);
+
+    nlohmann::json configuration = {{"Board", {{"Name", "Board"}}}};
+    persister.schedule(configuration);
+    configuration["Board"]["Type"] = "Board";
+    persister.schedule(configuration);
+    io.run();
+
+    // only the configuration as it was at the time of the write is written
+    EXPECT_EQ(persister.writes(), 1U);
+    std::ifstream file(dir / "system.json");
+    EXPECT_EQ(nlohmann::json::parse(file), configuration);
+    EXPECT_EQ(persister.bytesWritten(),
+              std::filesystem::file_size(dir / "system.json"));
+    EXPECT_FALSE(std::filesystem::exists(dir / "system.json.tmp"));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ConfigurationPersister, flushWritesNow)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                                "test_configuration_persister_flush";
+    std::filesystem::remove_all(dir);
+    boost::asio::io_context io;
+    ConfigurationPersister persister(io, dir / "system.json", 1h,
+                                     ConfigurationPersister::SyncPolicy::never);
+
+    nlohmann::json configuration = {{"Board", {{"Name", "Board"}}}};
+    EXPECT_TRUE(persister.flush());
+    EXPECT_EQ(persister.writes(), 0U);
+
+    persister.schedule(configuration);
+    EXPECT_TRUE(persister.flush());
+    EXPECT_EQ(persister.writes(), 1U);
+    EXPECT_TRUE(std::filesystem::exists(dir / "system.json"));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ConfigurationPersister, journalReplay)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                                "test_configuration_persister_journal";
+    std::filesystem::remove_all(dir);
+    boost::asio::io_context io;
+    ConfigurationPersister persister(
+        io, dir / "system.json", 10ms,
+        ConfigurationPersister::SyncPolicy::never,
+        ConfigurationPersister::Mode::journal);
+
+    nlohmann::json configuration = {
+        {"Board", {{"Name", "Board"}, {"Exposes", {{{"Name", "Fan"}}}}}}};
+    persister.schedule(configuration);
+    EXPECT_TRUE(persister.flush());
+    nlohmann::json compacted = configuration;
+
+    configuration["Board"]["Exposes"][0]["Name"] = "Pump";
+    persister.recordChange(configuration, "/Board/Exposes/0/Name");
+    configuration["Board"]["Exposes"][0] = nullptr;
+    persister.recordChange(configuration, "/Board/Exposes/0");
+    EXPECT_EQ(persister.writes(), 1U);
+
+    // a change torn by a power loss is ignored
+    {
+        std::ofstream journal(persister.journalPath(), std::ios::app);
+        journal << R"({"Pointer": "/Board/Name", "Val)";
+    }
+
+    std::ifstream file(dir / "system.json");
+    nlohmann::json replayed = nlohmann::json::parse(file);
+    EXPECT_EQ(replayed, compacted);
+    EXPECT_EQ(ConfigurationPersister::replayJournal(persister.journalPath(),
+                                                    replayed),
+              2U);
+    EXPECT_EQ(replayed, configuration);
+
+    // compacting writes the file and drops the journal
+    persister.schedule(configuration);
+    EXPECT_TRUE(persister.flush());
+    EXPECT_FALSE(std::filesystem::exists(persister.journalPath()));
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ConfigurationPersister, background)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                                "test_configuration_persister_background";
+    std::filesystem::remove_all(dir);
+    boost::asio::io_context io;
+    ConfigurationPersister persister(
+        io, dir / "system.json", 0ms, ConfigurationPersister::SyncPolicy::never,
+        ConfigurationPersister::Mode::snapshot, std::chrono::minutes(5), true);
+
+    nlohmann::json configuration = {{"Board", {{"Name", "Board"}}}};
+    persister.schedule(configuration);
+    EXPECT_TRUE(persister.flush());
+    // the worker was handed the serialized configuration, so this change
+    // isn't written
+    nlohmann::json written = configuration;
+    configuration["Board"]["Type"] = "Board";
+
+    // the worker posts back to the io loop when it's done
+    auto work = boost::asio::make_work_guard(io);
+    for (int i = 0; i < 100 && persister.writes() == 0; i++)
+    {
+        io.run_for(10ms);
+    }
+    EXPECT_EQ(persister.writes(), 1U);
+    EXPECT_EQ(persister.writtenVersion(), 1U);
+    std::ifstream file(dir / "system.json");
+    EXPECT_EQ(nlohmann::json::parse(file), written);
+    std::filesystem::remove_all(dir);
+}
@@ -139,6 +139,34 @@ TEST(TemplateCharReplace, divide)
     EXPECT_EQ(expected, j["foo"]);
 }
 
+// A replaceStr sends the value through the general substitution, which has to
+// evaluate as a template plan does
+TEST(TemplateCharReplace, replaceStrPrecedence)
+{
+    nlohmann::json j = {{"foo", "$TEST + 1 * 2 on Fan_N"}};
+    auto it = j.begin();
+    DBusInterface data;
+    data["TEST"] = 4;
+
+    templateCharReplace(it, data, 3, "_N"s);
+
+    nlohmann::json expected = "6 on Fan3";
+    EXPECT_EQ(expected, j["foo"]);
+}
+
+TEST(TemplateCharReplace, replaceStrDivideByZero)
+{
+    nlohmann::json j = {{"foo", "$TEST / 0 on Fan_N"}};
+    auto it = j.begin();
+    DBusInterface data;
+    data["TEST"] = 4;
+
+    EXPECT_NO_THROW(templateCharReplace(it, data, 3, "_N"s));
+
+    nlohmann::json expected = "$TEST / 0 on Fan3";
+    EXPECT_EQ(expected, j["foo"]);
+}
+
 TEST(TemplateCharReplace, multiMath)
 {
     nlohmann::json j = {{"foo", "4 * 2 % 6 equals $TEST * 2 % 6"}};
@@ -239,6 +267,222 @@ TEST(TemplateCharReplace, singleHex)
     EXPECT_EQ(expected, j["foo"]);
 }
 
+TEST(ExpressionProgram, precedence)
+{
+    std::vector<std::string> words = {"+", "4", "*", "2", "-", "6", "/", "3"};
+    std::vector<std::string>::const_iterator end = words.end();
+    auto program = expression::Program::compile(words.begin(), end, "$index");
+    ASSERT_TRUE(program);
+    EXPECT_EQ(end, words.end());
+    EXPECT_EQ(program->run(1, 0), 7);
+}
+
+TEST(ExpressionProgram, stopsAtNonOperator)
+{
+    std::vector<std::string> words = {"%", "4", "+", "$index", "Twinlake"};
+    std::vector<std::string>::const_iterator end = words.end();
+    auto program = expression::Program::compile(words.begin(), end, "$index");
+    ASSERT_TRUE(program);
+    EXPECT_EQ(end - words.cbegin(), 4);
+    EXPECT_EQ(program->run(0x55, 88), 89);
+}
+
+TEST(ExpressionProgram, sixtyFourBit)
+{
+    std::vector<std::string> words = {"*", "0x100000000"};
+    std::vector<std::string>::const_iterator end = words.end();
+    auto program = expression::Program::compile(words.begin(), end, "$index");
+    ASSERT_TRUE(program);
+    EXPECT_EQ(program->run(3, 0), 0x300000000);
+    EXPECT_FALSE(program->run(INT64_MAX, 0));
+}
+
+TEST(ExpressionProgram, invalid)
+{
+    std::vector<std::string> words = {"+", "foo"};
+    std::vector<std::string>::const_iterator end = words.end();
+    EXPECT_FALSE(expression::Program::compile(words.begin(), end, "$index"));
+
+    words = {"/", "0"};
+    end = words.end();
+    auto program = expression::Program::compile(words.begin(), end, "$index");
+    ASSERT_TRUE(program);
+    EXPECT_FALSE(program->run(4, 0));
+}
+
+TEST(TemplateCharReplace, divideByZero)
+{
+    nlohmann::json j = {{"foo", "$TEST / 0 apples"}};
+    auto it = j.begin();
+    DBusInterface data;
+    data["TEST"] = 4;
+
+    templateCharReplace(it, data, 0);
+
+    nlohmann::json expected = "$TEST / 0 apples";
+    EXPECT_EQ(expected, j["foo"]);
+}
+
+TEST(TemplateCharReplace, mathPrecedence)
+{
+    nlohmann::json j = {{"foo", "$TEST + 4 * 2"}};
+    auto it = j.begin();
+    DBusInterface data;
+    data["TEST"] = 1;
+
+    templateCharReplace(it, data, 0);
+
+    nlohmann::json expected = 9;
+    EXPECT_EQ(expected, j["foo"]);
+}
+
+TEST(TemplatePlan, tokens)
+{
+    TemplatePlan plan = TemplatePlan::compile("$bus sensor $index + $ADDRESS");
+    ASSERT_FALSE(plan.generic);
+    EXPECT_FALSE(plan.wholeValue);
+    ASSERT_EQ(plan.tokens.size(), 5U);
+    EXPECT_EQ(plan.tokens[0].kind, TemplatePlan::Kind::property);
+    EXPECT_EQ(plan.tokens[0].text, "bus");
+    EXPECT_EQ(plan.tokens[1].kind, TemplatePlan::Kind::literal);
+    EXPECT_EQ(plan.tokens[1].text, " sensor ");
+    EXPECT_EQ(plan.tokens[2].kind, TemplatePlan::Kind::index);
+    EXPECT_EQ(plan.tokens[3].text, " + ");
+    EXPECT_EQ(plan.tokens[4].text, "ADDRESS");
+}
+
+TEST(TemplatePlan, arithmetic)
+{
+    TemplatePlan plan = TemplatePlan::compile("$TEST * 2 % 6 equals");
+    ASSERT_FALSE(plan.generic);
+    ASSERT_EQ(plan.tokens.size(), 2U);
+    EXPECT_EQ(plan.tokens[0].text, "TEST");
+    EXPECT_EQ(plan.tokens[0].expression,
+              (std::vector<std::string>{"*", "2", "%", "6"}));
+    EXPECT_EQ(plan.tokens[1].text, " equals");
+
+    EXPECT_TRUE(TemplatePlan::compile("$TEST / $OTHER").generic);
+    EXPECT_TRUE(TemplatePlan::compile("$TEST +").generic);
+}
+
+TEST(TemplatePlan, wholeValue)
+{
+    EXPECT_TRUE(TemplatePlan::compile("$ADDRESS").wholeValue);
+    EXPECT_FALSE(TemplatePlan::compile("$ADDRESS ").wholeValue);
+    EXPECT_FALSE(TemplatePlan::compile("$index").wholeValue);
+}
+
+TEST(TemplateCharReplace, exactPropertyPreferred)
+{
+    nlohmann::json j = {{"foo", "$BusNumber"}};
+    auto it = j.begin();
+    DBusInterface data;
+    data["Bus"] = 1;
+    data["BusNumber"] = 2;
+
+    templateCharReplace(it, data, 0);
+
+    nlohmann::json expected = 2;
+    EXPECT_EQ(expected, j["foo"]);
+}
+
+TEST(TemplateCharReplace, indexInExpression)
+{
+    nlohmann::json j = {{"foo", "$ADDRESS + $index"}};
+    auto it = j.begin();
+    DBusInterface data;
+    data["ADDRESS"] = 80;
+
+    templateCharReplace(it, data, 3);
+
+    nlohmann::json expected = 83;
+    EXPECT_EQ(expected, j["foo"]);
+}
+
+TEST(PropertyProjection, templateReferences)
+{
+    nlohmann::json j = {{"Name", "$bus Riser $index"},
+                        {"Exposes", {{{"Address", "$ADDRESS + 1"}}}}};
+    PropertyProjection projection;
+    projection.addTemplateReferences(j);
+
+    EXPECT_TRUE(projection.wantsProperty("iface", "BUS"));
+    EXPECT_TRUE(projection.wantsProperty("iface", "Address"));
+    EXPECT_FALSE(projection.wantsProperty("iface", "index"));
+    EXPECT_FALSE(projection.wantsProperty("iface", "Serial"));
+    EXPECT_TRUE(projection.wantsInterface("iface"));
+}
+
+TEST(PropertyProjection, prefixOfReference)
+{
+    nlohmann::json j = "$BusNumber";
+    PropertyProjection projection;
+    projection.addTemplateReferences(j);
+
+    EXPECT_TRUE(projection.wantsProperty("iface", "Bus"));
+    EXPECT_TRUE(projection.wantsProperty("iface", "BusNumber"));
+    EXPECT_FALSE(projection.wantsProperty("iface", "BusNumbers"));
+}
+
+TEST(PropertyProjection, probedInterfaceIsWhole)
+{
+    PropertyProjection projection;
+    projection.probedInterfaces.emplace("probed");
+
+    EXPECT_TRUE(projection.wantsProperty("probed", "Anything"));
+    EXPECT_FALSE(projection.wantsProperty("other", "Anything"));
+    EXPECT_TRUE(projection.wantsInterface("probed"));
+    EXPECT_FALSE(projection.wantsInterface("other"));
+}
+
+TEST(RecordName, golden)
+{
+    DBusInterface probe;
+    probe["BUS"] = uint32_t(7);
+    probe["ADDRESS"] = uint32_t(0x50);
+    probe["BOARD_PRODUCT_NAME"] = std::string("Backplane");
+    probe["Present"] = true;
+    probe["Offset"] = int64_t(-1);
+    probe["Scale"] = 0.5;
+    probe["Data"] = std::vector<uint8_t>{1, 2, 3};
+
+    // Record names are persisted, so the hash must never change for a given
+    // recordNameVersion.
+    EXPECT_EQ(getRecordName(probe, "Backplane $index"), "v1-4eefb2df7d1c39e6");
+}
+
+TEST(RecordName, distinguishes)
+{
+    DBusInterface probe;
+    probe["BUS"] = uint32_t(7);
+    std::string name = getRecordName(probe, "Backplane");
+
+    probe["BUS"] = uint32_t(8);
+    EXPECT_NE(getRecordName(probe, "Backplane"), name);
+
+    probe["BUS"] = std::string("7");
+    EXPECT_NE(getRecordName(probe, "Backplane"), name);
+
+    probe["BUS"] = uint32_t(7);
+    EXPECT_EQ(getRecordName(probe, "Backplane"), name);
+    EXPECT_NE(getRecordName(probe, "Backplane2"), name);
+}
+
+TEST(RecordName, emptyProbe)
+{
+    EXPECT_EQ(getRecordName({}, "Chassis"), "Chassis");
+    EXPECT_EQ(getLegacyRecordName({}, "Chassis"), "Chassis");
+}
+
+TEST(SanitizeDbusName, replacesIllegal)
+{
+    EXPECT_EQ(sanitizeDbusName("Riser 1 (PCIe)"), "Riser_1__PCIe_");
+    EXPECT_EQ(sanitizeDbusName("PSU1.Fan-2"), "PSU1_Fan_2");
+    EXPECT_EQ(sanitizeDbusName("PSU1.Fan-2", true), "PSU1.Fan_2");
+    EXPECT_EQ(sanitizeDbusName("caf\xc3\xa9"), "caf__");
+    EXPECT_EQ(sanitizeDbusName(""), "");
+}
+
 TEST(MatchProbe, stringEqString)
 {
     nlohmann::json j = R"("foo")"_json;
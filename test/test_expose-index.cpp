@@ -0,0 +1,56 @@
+#include "expose_index.hpp"
+
+#include "gtest/gtest.h"
+
+using Location = ExposeNameIndex::Location;
+
+const nlohmann::json systemConfiguration = nlohmann::json::parse(R"(
+    {
+        "B": {
+            "Exposes": [
+                {"Name": "Connector", "Type": "Port"},
+                {"Name": "Fan", "Type": "Fan"}
+            ],
+            "Name": "Board B"
+        },
+        "A": {
+            "Exposes": [
+                {"Name": "Connector", "Type": "Port"},
+                {"Type": "Unnamed"},
+                {"Name": "Sensor", "Type": "TempSensor"}
+            ],
+            "Name": "Board A"
+        },
+        "C": {
+            "Name": "No Exposes"
+        }
+    }
+)");
+
+TEST(ExposeNameIndex, ordered)
+{
+    ExposeNameIndex index;
+    index.addRecords(systemConfiguration);
+
+    EXPECT_EQ(index.find("Connector"),
+              (std::set<Location>{{"A", 0}, {"B", 0}}));
+    EXPECT_EQ(index.find("Sensor"), (std::set<Location>{{"A", 2}}));
+    EXPECT_TRUE(index.find("Missing").empty());
+}
+
+TEST(ExposeNameIndex, replaceAndRemove)
+{
+    ExposeNameIndex index;
+    index.addRecords(systemConfiguration);
+
+    nlohmann::json record = systemConfiguration["B"];
+    record["Exposes"].erase(0);
+    index.addRecord("B", record);
+    EXPECT_EQ(index.find("Connector"), (std::set<Location>{{"A", 0}}));
+    EXPECT_EQ(index.find("Fan"), (std::set<Location>{{"B", 0}}));
+
+    index.removeRecord("A");
+    EXPECT_TRUE(index.find("Connector").empty());
+    EXPECT_TRUE(index.find("Sensor").empty());
+    EXPECT_EQ(index.find("Fan"), (std::set<Location>{{"B", 0}}));
+}
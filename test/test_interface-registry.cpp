@@ -0,0 +1,65 @@
+#include "interface_registry.hpp"
+
+#include "gtest/gtest.h"
+
+struct FakeInterface
+{
+    int id;
+};
+
+TEST(InterfaceRegistry, removeBoard)
+{
+    InterfaceRegistry<FakeInterface> registry;
+    auto a = std::make_shared<FakeInterface>(FakeInterface{1});
+    auto b = std::make_shared<FakeInterface>(FakeInterface{2});
+    auto c = std::make_shared<FakeInterface>(FakeInterface{3});
+    registry.add("BoardA", a);
+    registry.add("BoardA", b);
+    registry.add("BoardB", c);
+
+    std::vector<int> removed;
+    registry.removeBoard(registry.intern("BoardA"),
+                         [&removed](const auto& iface) {
+        removed.push_back(iface->id);
+    });
+    EXPECT_EQ(removed, (std::vector<int>{1, 2}));
+    EXPECT_EQ(registry.size(registry.intern("BoardA")), 0U);
+    EXPECT_EQ(registry.size(registry.intern("BoardB")), 1U);
+}
+
+TEST(InterfaceRegistry, staleHandle)
+{
+    InterfaceRegistry<FakeInterface> registry;
+    auto a = std::make_shared<FakeInterface>(FakeInterface{1});
+    auto b = std::make_shared<FakeInterface>(FakeInterface{2});
+    auto handle = registry.add("Board", a);
+    EXPECT_EQ(registry.get(handle), a);
+    EXPECT_TRUE(registry.release(handle));
+    EXPECT_FALSE(registry.release(handle));
+
+    // the slot is reused, but the old handle doesn't find the new interface
+    auto reused = registry.add("Board", b);
+    EXPECT_EQ(reused.slot, handle.slot);
+    EXPECT_EQ(registry.get(handle), nullptr);
+    EXPECT_EQ(registry.get(reused), b);
+}
+
+TEST(InterfaceRegistry, sweepExpired)
+{
+    InterfaceRegistry<FakeInterface> registry;
+    auto board = registry.intern("Board");
+    auto kept = std::make_shared<FakeInterface>(FakeInterface{1});
+    registry.add(board, kept);
+    for (int i = 0; i < 100; i++)
+    {
+        // removed behind the registry's back, as by a Delete method
+        registry.add(board, std::make_shared<FakeInterface>(FakeInterface{i}));
+    }
+    EXPECT_LT(registry.size(board), 32U);
+
+    registry.sweep(board);
+    EXPECT_EQ(registry.size(board), 1U);
+    size_t live = 0;
+    registry.forEach(board, [&live](const auto&) { live++; });
+    EXPECT_EQ(live, 1U);
+}
@@ -0,0 +1,89 @@
+#include "property_binding.hpp"
+
+#include "gtest/gtest.h"
+
+const nlohmann::json systemConfiguration = nlohmann::json::parse(R"(
+    {
+        "v1-0123": {
+            "Exposes": [
+                {"Name": "Fan", "Type": "Fan", "Pwm": 3}
+            ],
+            "Name": "Board",
+            "Type": "Board",
+            "xyz.openbmc_project.Inventory.Item.Board": {"Name": "Override"}
+        }
+    }
+)");
+
+TEST(PropertyBinding, find)
+{
+    RecordBindings bindings;
+    InterfaceBinding fan(bindings.get("v1-0123"), "/Exposes/0");
+    ASSERT_NE(fan.find(systemConfiguration, "Pwm"), nullptr);
+    EXPECT_EQ(*fan.find(systemConfiguration, "Pwm"), 3);
+    EXPECT_EQ(fan.find(systemConfiguration, "Missing"), nullptr);
+    EXPECT_EQ(fan.jsonPointer(), "/v1-0123/Exposes/0");
+
+    InterfaceBinding gone(bindings.get("v1-0123"), "/Exposes/1");
+    EXPECT_EQ(gone.find(systemConfiguration, "Pwm"), nullptr);
+}
+
+TEST(PropertyBinding, overrides)
+{
+    RecordBindings bindings;
+    InterfaceBinding board(bindings.get("v1-0123"), "",
+                           "xyz.openbmc_project.Inventory.Item.Board");
+    EXPECT_EQ(*board.find(systemConfiguration, "Name"), "Override");
+    EXPECT_EQ(*board.find(systemConfiguration, "Type"), "Board");
+    EXPECT_EQ(board.jsonPointer(), "/v1-0123");
+}
+
+TEST(PropertyBinding, rename)
+{
+    RecordBindings bindings;
+    InterfaceBinding fan(bindings.get("v1-old"), "/Exposes/0");
+    EXPECT_EQ(fan.find(systemConfiguration, "Pwm"), nullptr);
+
+    bindings.rename("v1-old", "v1-0123");
+    EXPECT_EQ(*fan.find(systemConfiguration, "Pwm"), 3);
+    EXPECT_EQ(bindings.get("v1-0123"), bindings.get("v1-0123"));
+
+    bindings.remove("v1-0123");
+    EXPECT_EQ(*fan.find(systemConfiguration, "Pwm"), 3);
+}
+
+TEST(PropertyBinding, intern)
+{
+    const std::string& name = internPropertyName("Pwm");
+    EXPECT_EQ(&internPropertyName(std::string("Pwm")), &name);
+    EXPECT_NE(&internPropertyName("Name"), &name);
+}
+
+struct FakeInterface
+{
+    bool signal_property(const std::string& name)
+    {
+        signalled.push_back(name);
+        return true;
+    }
+
+    std::vector<std::string> signalled;
+};
+
+TEST(PropertyBinding, writeSignals)
+{
+    nlohmann::json configuration = systemConfiguration;
+    RecordBindings bindings;
+    InterfaceBinding fan(bindings.get("v1-0123"), "/Exposes/0");
+    FakeInterface iface;
+
+    EXPECT_TRUE(writeBoundProperty(configuration, fan.jsonPointer() + "/Pwm",
+                                   iface, "Pwm", 7));
+    EXPECT_EQ(*fan.find(configuration, "Pwm"), 7);
+    EXPECT_EQ(iface.signalled, std::vector<std::string>{"Pwm"});
+
+    EXPECT_FALSE(writeBoundProperty(configuration,
+                                    fan.jsonPointer() + "/Pwm/Speed", iface,
+                                    "Speed", 1));
+    EXPECT_EQ(iface.signalled.size(), 1U);
+}
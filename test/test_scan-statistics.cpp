@@ -0,0 +1,63 @@
+#include "scan_statistics.hpp"
+
+#include "gtest/gtest.h"
+
+using namespace std::chrono_literals;
+
+TEST(ScanStatistics, bucketBoundaries)
+{
+    EXPECT_EQ(ScanStatistics::bucket(0us), 0U);
+    EXPECT_EQ(ScanStatistics::bucket(1us), 0U);
+    EXPECT_EQ(ScanStatistics::bucket(2us), 1U);
+    EXPECT_EQ(ScanStatistics::bucket(3us), 1U);
+    EXPECT_EQ(ScanStatistics::bucket(4us), 2U);
+    EXPECT_EQ(ScanStatistics::bucket(1ms), 9U);
+    EXPECT_EQ(ScanStatistics::bucket(1h), ScanStatistics::buckets - 1);
+}
+
+TEST(ScanStatistics, recordAndRetry)
+{
+    ScanStatistics stats;
+    stats.record("xyz.openbmc_project.FruDevice",
+                 "xyz.openbmc_project.FruDevice", "GetAll", 3us, false);
+    stats.record("xyz.openbmc_project.FruDevice",
+                 "xyz.openbmc_project.FruDevice", "GetAll", 5ms, true);
+    stats.retry("xyz.openbmc_project.FruDevice",
+                "xyz.openbmc_project.FruDevice", "GetAll");
+    stats.record("xyz.openbmc_project.ObjectMapper",
+                 "xyz.openbmc_project.ObjectMapper", "GetSubTree", 1ms, false);
+
+    ASSERT_EQ(stats.entries().size(), 2U);
+    const ScanStatistics::Entry& fru = stats.entries().at(
+        ScanStatistics::Key("xyz.openbmc_project.FruDevice",
+                            "xyz.openbmc_project.FruDevice", "GetAll"));
+    EXPECT_EQ(fru.calls, 2U);
+    EXPECT_EQ(fru.errors, 1U);
+    EXPECT_EQ(fru.retries, 1U);
+    EXPECT_EQ(fru.histogram[1], 1U);
+    EXPECT_EQ(fru.histogram[12], 1U);
+
+    std::vector<ScanStatistics::Row> rows = stats.rows();
+    ASSERT_EQ(rows.size(), 2U);
+    EXPECT_EQ(std::get<0>(rows[1]), "xyz.openbmc_project.ObjectMapper");
+    EXPECT_EQ(std::get<3>(rows[1]), 1U);
+    EXPECT_EQ(std::get<6>(rows[1]).size(), ScanStatistics::buckets);
+}
+
+TEST(ScanStatistics, publishSlices)
+{
+    ScanStatistics stats;
+    stats.recordPublishSlice(3ms, 12);
+    stats.recordPublishSlice(40us, 1);
+
+    const ScanStatistics::PublishEntry& publish = stats.publishEntry();
+    EXPECT_EQ(publish.slices, 2U);
+    EXPECT_EQ(publish.records, 13U);
+    EXPECT_EQ(publish.longestMicroseconds, 3000U);
+    EXPECT_EQ(publish.histogram[5], 1U);
+    EXPECT_EQ(publish.histogram[11], 1U);
+
+    ScanStatistics::PublishRow row = stats.publishRow();
+    EXPECT_EQ(std::get<0>(row), 2U);
+    EXPECT_EQ(std::get<3>(row).size(), ScanStatistics::buckets);
+}
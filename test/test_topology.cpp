@@ -318,3 +318,39 @@ TEST(Topology, Remove)
         EXPECT_EQ(assocs.size(), 0);
     }
 }
+
+TEST(Topology, ChangesOnAdd)
+{
+    Topology topo;
+
+    topo.addBoard(superchassisPath, "Chassis", "BoardB",
+                  superchassisExposesItem);
+    EXPECT_EQ(topo.takeChanges().size(), 0);
+
+    // only the board that gained an association is reported
+    topo.addBoard(subchassisPath, "Chassis", "BoardA", subchassisExposesItem);
+    auto changes = topo.takeChanges();
+    EXPECT_EQ(changes.size(), 1);
+    EXPECT_THAT(changes[subchassisPath], UnorderedElementsAre(subchassisAssoc));
+
+    EXPECT_EQ(topo.takeChanges().size(), 0);
+}
+
+TEST(Topology, ChangesOnRemove)
+{
+    Topology topo;
+
+    topo.addBoard(subchassisPath, "Chassis", "BoardA", powerExposesItem);
+    topo.addBoard(superchassisPath, "Chassis", "BoardB",
+                  superchassisExposesItem);
+    auto changes = topo.takeChanges();
+    EXPECT_EQ(changes.size(), 2);
+    EXPECT_THAT(changes[superchassisPath], UnorderedElementsAre(powerAssoc));
+
+    // the superchassis is left without associations
+    topo.remove("BoardA");
+    changes = topo.takeChanges();
+    EXPECT_EQ(changes.size(), 1);
+    EXPECT_EQ(changes[superchassisPath].size(), 0);
+    EXPECT_EQ(topo.getAssociations(subchassisPath), nullptr);
+}